@@ -0,0 +1,1187 @@
+/*
+ * Discrete-event simulator for the DIO replay mitigation.
+ *
+ * Runs rpl-dio-replay-mitigation.c, unchanged, on thousands of virtual
+ * nodes in one process. The firmware object is linked once. Its .data
+ * and .bss are renamed to mit_data/mit_bss at build time, and the core
+ * swaps that block in and out whenever a different node runs, so every
+ * node keeps its own copy of the static state.
+ *
+ * The radio is a unit disk graph. Received frames carry an RSSI from a
+ * log-distance path loss with per-frame fading, and an LQI that follows
+ * it, so a relayed frame arrives with the relay's signal. The DODAG is
+ * static: ranks come from
+ * ETX-style link metrics via shortest path from the root, and every
+ * joined node emits DIOs on its own Trickle timer. Attackers are extra
+ * nodes that record DIOs they overhear and periodically replay them
+ * byte for byte, like rpl-dio-attacker.c. Each DIO a protected node
+ * receives is labelled genuine or replay, so the firmware's verdicts
+ * give exact detection counts and latencies.
+ *
+ * With --dao-interval, every joined node also sends non-storing DAOs,
+ * with the RPL hop-by-hop option, up its parent chain to the root, which
+ * then runs the firmware as well. Attackers record the DAOs they overhear
+ * and replay them towards the root through their best-ranked neighbor.
+ */
+#include "dessim.h"
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+
+/* Firmware state block, delimited by the linker for the renamed sections */
+extern char __start_mit_data[], __stop_mit_data[];
+extern char __start_mit_bss[], __stop_mit_bss[];
+extern struct process *const autostart_processes[];
+
+/* RPL Lite defaults */
+#define MIN_HOPRANKINC 128
+#define DIO_INTERVAL_MIN 12 /* 2^12 ms */
+#define DIO_INTERVAL_DOUBLINGS 8
+#define DIO_REDUNDANCY 0   /* 0 disables Trickle suppression */
+#define DODAG_VERSION 240
+#define INSTANCE_ID 0
+#define ETX_DIVISOR 128
+
+/* Radio: log-distance path loss and fading */
+#define RSSI_AT_1M -40.0   /* dBm */
+#define PATH_LOSS_EXP 3.0
+#define FADING_DB 3.0      /* Triangular, +- this much per frame */
+
+#define MAX_CAPTURED 10    /* Same ring size as rpl-dio-attacker.c */
+#define GROUND_TRUTH_FLOW_LABEL 0xBADD1 /* Must match the firmware */
+#define FRAME_MAX 192
+#define RPL_HBH_OPTION 0x63
+#define RPL_OPTION_TARGET 5
+#define RPL_OPTION_TRANSIT 6
+#define DAO_LIFETIME 30
+
+enum {
+  EV_BOOT,
+  EV_TIMER,
+  EV_POLL,
+  EV_TRICKLE_TX,
+  EV_TRICKLE_END,
+  EV_DELIVER,
+  EV_ATTACK,
+  EV_DAO,
+  EV_DAO_HOP,
+};
+
+typedef struct {
+  uint64_t time;
+  uint64_t seq; /* Ties run in scheduling order, keeping runs deterministic */
+  uint32_t node;
+  uint8_t type;
+  union {
+    struct etimer *et;
+    uint32_t frame;
+  } u;
+} event_t;
+
+typedef struct {
+  uint16_t len;
+  uint8_t replay;
+  uint32_t next_free;
+  uint8_t data[FRAME_MAX];
+} frame_t;
+
+typedef struct {
+  uint16_t id;
+  uint8_t is_root;
+  uint8_t is_attacker;
+  uint8_t joined;
+  uint8_t poll_pending;
+  double x, y;
+  rpl_rank_t rank;
+  int parent; /* Index into nbrs, -1 at the root */
+  rpl_nbr_t *nbrs;
+  uint32_t *nbr_node;
+  int n_nbrs;
+  uint8_t *state; /* This node's copy of mit_data + mit_bss */
+  /* Trickle */
+  uint8_t doublings;
+  uint64_t interval_start;
+  uint32_t heard;
+  /* Attacker capture rings, DIOs and DAOs */
+  uint32_t captured[MAX_CAPTURED];
+  uint8_t cap_count, cap_next;
+  uint32_t dao_captured[MAX_CAPTURED];
+  uint8_t dao_cap_count, dao_cap_next;
+  uint8_t dao_seq;
+  /* Ground truth */
+  uint32_t rx_genuine, rx_replay, drop_genuine, drop_replay;
+  uint64_t first_replay_rx, first_replay_drop;
+} node_t;
+
+static struct {
+  unsigned nodes;
+  unsigned attackers;
+  double degree;
+  double range;
+  unsigned duration;
+  unsigned long seed;
+  double loss;
+  unsigned attack_start;
+  unsigned attack_interval;
+  unsigned replay_count;
+  unsigned dao_interval;
+  const char *log_path;
+  int log_level;
+} opt = { 100, 1, 8.0, 50.0, 3600, 123456, 0.0, 60, 10, 5, 0, NULL,
+          LOG_LEVEL_WARN };
+
+static node_t *nodes;
+static unsigned n_nodes;
+static node_t *current;
+static uint64_t now;
+static uint64_t rng_state;
+static FILE *log_file;
+
+static event_t *heap;
+static size_t heap_len, heap_cap;
+static uint64_t event_seq;
+static uint64_t events_run;
+
+static frame_t *frames;
+static uint32_t frames_cap, frame_free = UINT32_MAX;
+
+static size_t data_size, bss_size;
+static uint8_t *pristine_data;
+
+static uint64_t blacklist_events;
+static uint64_t timer_wakeups; /* Timer events the firmware actually ran */
+static uint64_t first_blacklist = UINT64_MAX;
+static uint64_t first_replay_tx = UINT64_MAX;
+static uint64_t dio_tx, replay_tx;
+
+/* DAO screening, counted where the DAO ends: at the root, at a forwarder
+ * that dropped it, or on the way for want of a parent or to loss */
+static struct {
+  uint64_t tx, replay_tx;
+  uint64_t rx_genuine, rx_replay, drop_genuine, drop_replay;
+  uint64_t fwd_drops, lost;
+} dao;
+
+/*---------------------------------------------------------------------------*/
+static uint64_t
+rng_next(void)
+{
+  /* xorshift64* */
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DULL;
+}
+/*---------------------------------------------------------------------------*/
+static double
+rng_unit(void)
+{
+  return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+/*---------------------------------------------------------------------------*/
+/* Uniform in [0, 1) from a key, without touching the run's random stream */
+static double
+hash_unit(uint64_t key)
+{
+  /* splitmix64 finalizer */
+  key += 0x9E3779B97F4A7C15ULL;
+  key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+  key ^= key >> 31;
+  return (key >> 11) * (1.0 / 9007199254740992.0);
+}
+/*---------------------------------------------------------------------------*/
+static void *
+xmalloc(size_t size)
+{
+  void *p = calloc(1, size);
+
+  if(p == NULL) {
+    fprintf(stderr, "dessim: out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+/* Event queue: binary min-heap on (time, seq) */
+static int
+event_before(const event_t *a, const event_t *b)
+{
+  return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule(uint64_t time, uint8_t type, node_t *n, event_t *proto)
+{
+  event_t ev;
+  size_t i;
+
+  if(heap_len == heap_cap) {
+    heap_cap = heap_cap ? heap_cap * 2 : 1024;
+    heap = realloc(heap, heap_cap * sizeof(event_t));
+    if(heap == NULL) {
+      fprintf(stderr, "dessim: out of memory\n");
+      exit(1);
+    }
+  }
+  if(proto != NULL) {
+    ev = *proto;
+  } else {
+    memset(&ev, 0, sizeof(ev));
+  }
+  ev.time = time;
+  ev.seq = event_seq++;
+  ev.type = type;
+  ev.node = n - nodes;
+
+  for(i = heap_len++; i > 0 && event_before(&ev, &heap[(i - 1) / 2]);
+      i = (i - 1) / 2) {
+    heap[i] = heap[(i - 1) / 2];
+  }
+  heap[i] = ev;
+}
+/*---------------------------------------------------------------------------*/
+static event_t
+pop_event(void)
+{
+  event_t top = heap[0];
+  event_t last = heap[--heap_len];
+  size_t i = 0, child;
+
+  while((child = 2 * i + 1) < heap_len) {
+    if(child + 1 < heap_len && event_before(&heap[child + 1], &heap[child])) {
+      child++;
+    }
+    if(!event_before(&heap[child], &last)) {
+      break;
+    }
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+  return top;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+frame_alloc(void)
+{
+  uint32_t i;
+
+  if(frame_free == UINT32_MAX) {
+    uint32_t old = frames_cap;
+    frames_cap = frames_cap ? frames_cap * 2 : 256;
+    frames = realloc(frames, frames_cap * sizeof(frame_t));
+    if(frames == NULL) {
+      fprintf(stderr, "dessim: out of memory\n");
+      exit(1);
+    }
+    for(i = frames_cap; i-- > old;) {
+      frames[i].next_free = frame_free;
+      frame_free = i;
+    }
+  }
+  i = frame_free;
+  frame_free = frames[i].next_free;
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+static void
+frame_release(uint32_t i)
+{
+  frames[i].next_free = frame_free;
+  frame_free = i;
+}
+/*---------------------------------------------------------------------------*/
+/* Cooja numbering: link address hi:lo repeated, IID with U/L bit flipped */
+static void
+node_ipaddr(uip_ipaddr_t *addr, uint16_t id, int global)
+{
+  int i;
+
+  memset(addr, 0, sizeof(*addr));
+  addr->u8[0] = global ? 0xfd : 0xfe;
+  addr->u8[1] = global ? 0x00 : 0x80;
+  for(i = 8; i < 16; i += 2) {
+    addr->u8[i] = id >> 8;
+    addr->u8[i + 1] = id & 0xff;
+  }
+  addr->u8[8] ^= 0x02;
+}
+/*---------------------------------------------------------------------------*/
+/* Make n the running node: swap the firmware state and its RPL view */
+static void
+switch_to(node_t *n)
+{
+  int i;
+
+  if(current != n) {
+    shim_log_flush();
+    if(current != NULL) {
+      memcpy(current->state, __start_mit_data, data_size);
+      memcpy(current->state + data_size, __start_mit_bss, bss_size);
+    }
+    memcpy(__start_mit_data, n->state, data_size);
+    memcpy(__start_mit_bss, n->state + data_size, bss_size);
+    current = n;
+
+    memset(&linkaddr_node_addr, 0, sizeof(linkaddr_node_addr));
+    for(i = 0; i < LINKADDR_SIZE; i += 2) {
+      linkaddr_node_addr.u8[i] = n->id >> 8;
+      linkaddr_node_addr.u8[i + 1] = n->id & 0xff;
+    }
+  }
+
+  memset(&curr_instance, 0, sizeof(curr_instance));
+  curr_instance.instance_id = INSTANCE_ID;
+  curr_instance.min_hoprankinc = MIN_HOPRANKINC;
+  curr_instance.dio_intmin = DIO_INTERVAL_MIN;
+  curr_instance.dio_redundancy = DIO_REDUNDANCY;
+  curr_instance.dag.version = DODAG_VERSION;
+  curr_instance.dag.state = n->joined ? DAG_REACHABLE : DAG_INITIALIZED;
+  curr_instance.dag.rank = n->joined ? n->rank : RPL_INFINITE_RANK;
+  curr_instance.dag.dio_intcurrent = DIO_INTERVAL_MIN + n->doublings;
+  curr_instance.dag.preferred_parent = n->parent >= 0 ?
+    &n->nbrs[n->parent] : NULL;
+  node_ipaddr(&curr_instance.dag.dag_id, nodes[0].id, 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Services for the shim */
+uint64_t
+sim_now(void)
+{
+  return now;
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_schedule_timer(struct etimer *et, uint64_t at)
+{
+  event_t ev;
+
+  ev.u.et = et;
+  schedule(at, EV_TIMER, current, &ev);
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_schedule_poll(void)
+{
+  if(!current->poll_pending) {
+    current->poll_pending = 1;
+    schedule(now, EV_POLL, current, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+sim_random(void)
+{
+  return (uint16_t)(rng_next() >> 48);
+}
+/*---------------------------------------------------------------------------*/
+rpl_nbr_t *
+sim_neighbors(int *count)
+{
+  *count = current->n_nbrs;
+  return current->nbrs;
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_log_line(int level, const char *line)
+{
+  if(strstr(line, "BLACKLISTED: ") != NULL) {
+    blacklist_events++;
+    if(first_blacklist == UINT64_MAX) {
+      first_blacklist = now;
+    }
+  }
+  if(log_file != NULL && level <= opt.log_level) {
+    fprintf(log_file, "%02lu:%02lu.%03lu\tID:%u\t%s\n",
+            (unsigned long)(now / 60000), (unsigned long)(now / 1000 % 60),
+            (unsigned long)(now % 1000), current->id, line);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_process(process_event_t ev, process_data_t data)
+{
+  struct process *p = autostart_processes[0];
+
+  p->thread(&p->pt, ev, data);
+}
+/*---------------------------------------------------------------------------*/
+/* Topology: uniform placement sized for the requested mean degree */
+static void
+build_topology(void)
+{
+  double side;
+  unsigned i, j;
+  int *cnt;
+  uint64_t *cost;
+  uint8_t *done;
+
+  n_nodes = opt.nodes + opt.attackers;
+  nodes = xmalloc(n_nodes * sizeof(node_t));
+  side = sqrt(opt.nodes * M_PI * opt.range * opt.range / opt.degree);
+
+  for(i = 0; i < n_nodes; i++) {
+    nodes[i].id = i + 1;
+    nodes[i].x = i == 0 ? side / 2 : rng_unit() * side;
+    nodes[i].y = i == 0 ? side / 2 : rng_unit() * side;
+    nodes[i].is_root = i == 0;
+    nodes[i].is_attacker = i >= opt.nodes;
+    nodes[i].parent = -1;
+    nodes[i].state = xmalloc(data_size + bss_size);
+    memcpy(nodes[i].state, pristine_data, data_size);
+  }
+
+  cnt = xmalloc(n_nodes * sizeof(int));
+  for(i = 0; i < n_nodes; i++) {
+    for(j = i + 1; j < n_nodes; j++) {
+      double dx = nodes[i].x - nodes[j].x, dy = nodes[i].y - nodes[j].y;
+      if(dx * dx + dy * dy <= opt.range * opt.range) {
+        cnt[i]++;
+        cnt[j]++;
+      }
+    }
+  }
+  for(i = 0; i < n_nodes; i++) {
+    nodes[i].nbrs = xmalloc((cnt[i] + 1) * sizeof(rpl_nbr_t));
+    nodes[i].nbr_node = xmalloc((cnt[i] + 1) * sizeof(uint32_t));
+  }
+  for(i = 0; i < n_nodes; i++) {
+    for(j = i + 1; j < n_nodes; j++) {
+      double dx = nodes[i].x - nodes[j].x, dy = nodes[i].y - nodes[j].y;
+      double d2 = dx * dx + dy * dy;
+      uint16_t metric;
+      if(d2 > opt.range * opt.range) {
+        continue;
+      }
+      /* ETX grows from 1 next to a node to 2 at the edge of range */
+      metric = ETX_DIVISOR + (uint16_t)(ETX_DIVISOR * d2 /
+                                         (opt.range * opt.range));
+      node_ipaddr(&nodes[i].nbrs[nodes[i].n_nbrs].ipaddr, nodes[j].id, 0);
+      nodes[i].nbrs[nodes[i].n_nbrs].link_metric = metric;
+      nodes[i].nbr_node[nodes[i].n_nbrs++] = j;
+      node_ipaddr(&nodes[j].nbrs[nodes[j].n_nbrs].ipaddr, nodes[i].id, 0);
+      nodes[j].nbrs[nodes[j].n_nbrs].link_metric = metric;
+      nodes[j].nbr_node[nodes[j].n_nbrs++] = i;
+    }
+  }
+  free(cnt);
+
+  /* Ranks by Dijkstra from the root over protected nodes only */
+  cost = xmalloc(n_nodes * sizeof(uint64_t));
+  done = xmalloc(n_nodes);
+  for(i = 0; i < n_nodes; i++) {
+    cost[i] = UINT64_MAX;
+  }
+  cost[0] = MIN_HOPRANKINC;
+  for(;;) {
+    unsigned best = n_nodes;
+    int k;
+    for(i = 0; i < opt.nodes; i++) {
+      if(!done[i] && cost[i] != UINT64_MAX &&
+         (best == n_nodes || cost[i] < cost[best])) {
+        best = i;
+      }
+    }
+    if(best == n_nodes) {
+      break;
+    }
+    done[best] = 1;
+    for(k = 0; k < nodes[best].n_nbrs; k++) {
+      j = nodes[best].nbr_node[k];
+      if(j < opt.nodes &&
+         cost[best] + nodes[best].nbrs[k].link_metric < cost[j]) {
+        cost[j] = cost[best] + nodes[best].nbrs[k].link_metric;
+      }
+    }
+  }
+  for(i = 0; i < opt.nodes; i++) {
+    int k;
+    if(cost[i] == UINT64_MAX || cost[i] >= RPL_INFINITE_RANK) {
+      continue;
+    }
+    nodes[i].joined = 1;
+    nodes[i].rank = cost[i];
+    for(k = 0; k < nodes[i].n_nbrs; k++) {
+      j = nodes[i].nbr_node[k];
+      if(j < opt.nodes && cost[j] != UINT64_MAX &&
+         cost[j] + nodes[i].nbrs[k].link_metric == cost[i]) {
+        nodes[i].parent = k;
+        break;
+      }
+    }
+  }
+  for(i = 0; i < n_nodes; i++) {
+    int k;
+    for(k = 0; k < nodes[i].n_nbrs; k++) {
+      j = nodes[i].nbr_node[k];
+      nodes[i].nbrs[k].rank = nodes[j].joined ? nodes[j].rank :
+        RPL_INFINITE_RANK;
+    }
+  }
+  free(cost);
+  free(done);
+}
+/*---------------------------------------------------------------------------*/
+/* Build n's next DIO in uip_buf and let its firmware see it on the way out */
+static uint32_t
+emit_dio(node_t *n)
+{
+  struct uip_icmp_hdr *icmp = (struct uip_icmp_hdr *)&uip_buf[UIP_IPH_LEN];
+  uint8_t *dio = &uip_buf[UIP_IPH_LEN + UIP_ICMPH_LEN];
+  uint16_t len = 0;
+  uint32_t f;
+
+  switch_to(n);
+  memset(uip_buf, 0, UIP_IPH_LEN + UIP_ICMPH_LEN + 24 + 16);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = 64;
+  node_ipaddr(&UIP_IP_BUF->srcipaddr, n->id, 0);
+  UIP_IP_BUF->destipaddr.u8[0] = 0xff;
+  UIP_IP_BUF->destipaddr.u8[1] = 0x02;
+  UIP_IP_BUF->destipaddr.u8[15] = 0x1a;
+  icmp->type = ICMP6_RPL;
+  icmp->icode = RPL_CODE_DIO;
+
+  dio[len++] = INSTANCE_ID;
+  dio[len++] = DODAG_VERSION;
+  dio[len++] = n->rank >> 8;
+  dio[len++] = n->rank & 0xff;
+  dio[len++] = 0x80 | (2 << 3); /* Grounded, MOP storing */
+  dio[len++] = 0;               /* DTSN */
+  dio[len++] = 0;
+  dio[len++] = 0;
+  node_ipaddr((uip_ipaddr_t *)&dio[len], nodes[0].id, 1);
+  len += 16;
+  /* DODAG configuration option */
+  dio[len++] = RPL_OPTION_DAG_CONF;
+  dio[len++] = 14;
+  dio[len++] = 0;
+  dio[len++] = DIO_INTERVAL_DOUBLINGS;
+  dio[len++] = DIO_INTERVAL_MIN;
+  dio[len++] = DIO_REDUNDANCY;
+  dio[len++] = (7 * MIN_HOPRANKINC) >> 8;
+  dio[len++] = (7 * MIN_HOPRANKINC) & 0xff;
+  dio[len++] = MIN_HOPRANKINC >> 8;
+  dio[len++] = MIN_HOPRANKINC & 0xff;
+  dio[len++] = 0;
+  dio[len++] = 1; /* OCP: MRHOF */
+  dio[len++] = 0;
+  dio[len++] = 30;
+  dio[len++] = 0;
+  dio[len++] = 60;
+
+  len += UIP_ICMPH_LEN;
+  UIP_IP_BUF->len[0] = len >> 8;
+  UIP_IP_BUF->len[1] = len & 0xff;
+  uip_len = UIP_IPH_LEN + len;
+  uip_ext_len = 0;
+  icmp->icmpchksum = 0;
+  icmp->icmpchksum = ~uip_icmp6chksum();
+
+  if(!n->is_root && sim_processor != NULL &&
+     sim_processor->process_output != NULL) {
+    sim_processor->process_output(NULL);
+  }
+
+  f = frame_alloc();
+  frames[f].len = uip_len < FRAME_MAX ? uip_len : FRAME_MAX;
+  frames[f].replay = 0;
+  memcpy(frames[f].data, uip_buf, frames[f].len);
+  return f;
+}
+/*---------------------------------------------------------------------------*/
+static void
+transmit(node_t *from, uint32_t f, uint64_t at)
+{
+  event_t ev;
+
+  ev.u.frame = f;
+  schedule(at, EV_DELIVER, from, &ev);
+  if(frames[f].replay) {
+    replay_tx++;
+    if(first_replay_tx == UINT64_MAX) {
+      first_replay_tx = at;
+    }
+  } else {
+    dio_tx++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Ground-truth label for firmware built with MITIGATION_CONF_WITH_GROUND_TRUTH:
+ * the IPv6 flow label, which RPL never looks at */
+static void
+tag_replay(frame_t *fr)
+{
+  fr->data[1] = (fr->data[1] & 0xF0) | ((GROUND_TRUTH_FLOW_LABEL >> 16) & 0x0F);
+  fr->data[2] = (GROUND_TRUTH_FLOW_LABEL >> 8) & 0xFF;
+  fr->data[3] = GROUND_TRUTH_FLOW_LABEL & 0xFF;
+}
+/*---------------------------------------------------------------------------*/
+static void
+capture(node_t *a, uint32_t src, int is_dao)
+{
+  uint32_t *ring = is_dao ? a->dao_captured : a->captured;
+  uint8_t *count = is_dao ? &a->dao_cap_count : &a->cap_count;
+  uint8_t *next = is_dao ? &a->dao_cap_next : &a->cap_next;
+  uint32_t f;
+  int i;
+
+  /* One slot per sender, newest copy wins, like the attacker's ring */
+  for(i = 0; i < *count; i++) {
+    if(memcmp(frames[ring[i]].data + 8, frames[src].data + 8, 16) == 0) {
+      f = ring[i];
+      frames[f].len = frames[src].len;
+      memcpy(frames[f].data, frames[src].data, frames[src].len);
+      tag_replay(&frames[f]);
+      return;
+    }
+  }
+  if(*count < MAX_CAPTURED) {
+    f = frame_alloc();
+    ring[(*count)++] = f;
+  } else {
+    f = ring[*next];
+    *next = (*next + 1) % MAX_CAPTURED;
+  }
+  /* frame_alloc() may have moved the pool */
+  frames[f].len = frames[src].len;
+  frames[f].replay = 1;
+  memcpy(frames[f].data, frames[src].data, frames[src].len);
+  tag_replay(&frames[f]);
+}
+/*---------------------------------------------------------------------------*/
+/* RSSI and LQI of one reception, from the sender's actual position */
+static void
+link_signal(const node_t *from, const node_t *to, uint64_t key)
+{
+  double dx = from->x - to->x, dy = from->y - to->y;
+  double d = sqrt(dx * dx + dy * dy);
+  double rssi;
+  double lqi;
+
+  rssi = RSSI_AT_1M - 10.0 * PATH_LOSS_EXP * log10(d > 1.0 ? d : 1.0) +
+    FADING_DB * (hash_unit(key) + hash_unit(key ^ 0x5555) - 1.0);
+  /* CC2420-like: LQI rises from 50 near sensitivity to 110 */
+  lqi = 50.0 + (rssi + 95.0) * 60.0 / 55.0;
+  sim_rx_rssi = (int16_t)lround(rssi);
+  sim_rx_lqi = (uint8_t)(lqi < 50.0 ? 50 : lqi > 110.0 ? 110 : lround(lqi));
+}
+/*---------------------------------------------------------------------------*/
+static void
+deliver(node_t *from, uint32_t f)
+{
+  int k;
+
+  for(k = 0; k < from->n_nbrs; k++) {
+    node_t *to = &nodes[from->nbr_node[k]];
+    frame_t *fr = &frames[f];
+    enum netstack_ip_action action;
+
+    if(opt.loss > 0 && rng_unit() < opt.loss) {
+      continue;
+    }
+    if(to->is_attacker) {
+      if(!fr->replay) {
+        capture(to, f, 0);
+      }
+      continue;
+    }
+    if(to->is_root || !to->joined) {
+      continue;
+    }
+    switch_to(to);
+    link_signal(from, to, ((uint64_t)events_run << 20) ^ to->id);
+    memcpy(uip_buf, fr->data, fr->len);
+    uip_len = fr->len;
+    uip_ext_len = 0;
+    action = sim_processor != NULL ? sim_processor->process_input() :
+      NETSTACK_IP_PROCESS;
+
+    if(fr->replay) {
+      to->rx_replay++;
+      if(to->first_replay_rx == 0) {
+        to->first_replay_rx = now;
+      }
+      if(action == NETSTACK_IP_DROP) {
+        to->drop_replay++;
+        if(to->first_replay_drop == 0) {
+          to->first_replay_drop = now;
+        }
+      }
+    } else {
+      to->rx_genuine++;
+      if(action == NETSTACK_IP_DROP) {
+        to->drop_genuine++;
+      } else {
+        to->heard++;
+      }
+    }
+  }
+  frame_release(f);
+}
+/*---------------------------------------------------------------------------*/
+/* Build n's next non-storing DAO to the root, as rpl-lite sends it: RPL
+ * hop-by-hop option, then target and transit information options */
+static uint32_t
+emit_dao(node_t *n)
+{
+  uint8_t *hbh = &uip_buf[UIP_IPH_LEN];
+  struct uip_icmp_hdr *icmp = (struct uip_icmp_hdr *)&hbh[8];
+  uint8_t *body = &hbh[8 + UIP_ICMPH_LEN];
+  node_t *parent = &nodes[n->nbr_node[n->parent]];
+  uint16_t len = 0;
+  uint32_t f;
+
+  switch_to(n);
+  memset(uip_buf, 0, UIP_IPH_LEN + 8 + UIP_ICMPH_LEN + 48);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = UIP_PROTO_HBHO;
+  UIP_IP_BUF->ttl = 64;
+  node_ipaddr(&UIP_IP_BUF->srcipaddr, n->id, 1);
+  node_ipaddr(&UIP_IP_BUF->destipaddr, nodes[0].id, 1);
+  hbh[0] = UIP_PROTO_ICMP6;
+  hbh[1] = 0;
+  hbh[2] = RPL_HBH_OPTION;
+  hbh[3] = 4;
+  hbh[4] = 0;
+  hbh[5] = INSTANCE_ID;
+  hbh[6] = n->rank >> 8;
+  hbh[7] = n->rank & 0xff;
+  icmp->type = ICMP6_RPL;
+  icmp->icode = RPL_CODE_DAO;
+
+  body[len++] = INSTANCE_ID;
+  body[len++] = 0; /* No ack requested, no DODAG ID */
+  body[len++] = 0;
+  body[len++] = n->dao_seq;
+  body[len++] = RPL_OPTION_TARGET;
+  body[len++] = 18;
+  body[len++] = 0;
+  body[len++] = 128;
+  node_ipaddr((uip_ipaddr_t *)&body[len], n->id, 1);
+  len += 16;
+  body[len++] = RPL_OPTION_TRANSIT;
+  body[len++] = 20;
+  body[len++] = 0;
+  body[len++] = 0;
+  body[len++] = 0;
+  body[len++] = DAO_LIFETIME;
+  node_ipaddr((uip_ipaddr_t *)&body[len], parent->id, 1);
+  len += 16;
+
+  len += 8 + UIP_ICMPH_LEN;
+  UIP_IP_BUF->len[0] = len >> 8;
+  UIP_IP_BUF->len[1] = len & 0xff;
+  uip_len = UIP_IPH_LEN + len;
+  uip_ext_len = 8;
+  icmp->icmpchksum = 0;
+  icmp->icmpchksum = ~uip_icmp6chksum();
+  uip_ext_len = 0;
+
+  if(sim_processor != NULL && sim_processor->process_output != NULL) {
+    sim_processor->process_output(NULL);
+  }
+  RPL_LOLLIPOP_INCREMENT(n->dao_seq);
+
+  f = frame_alloc();
+  frames[f].len = uip_len;
+  frames[f].replay = 0;
+  memcpy(frames[f].data, uip_buf, uip_len);
+  return f;
+}
+/*---------------------------------------------------------------------------*/
+/* One DAO hop from 'from' to 'to'; attackers in range of 'from' record it */
+static void
+send_dao(node_t *from, uint32_t f, node_t *to)
+{
+  event_t ev;
+  int k;
+
+  if(!frames[f].replay) {
+    for(k = 0; k < from->n_nbrs; k++) {
+      if(nodes[from->nbr_node[k]].is_attacker) {
+        capture(&nodes[from->nbr_node[k]], f, 1);
+      }
+    }
+  }
+  ev.u.frame = f;
+  schedule(now + 1, EV_DAO_HOP, to, &ev);
+}
+/*---------------------------------------------------------------------------*/
+/* A DAO reaches n: its firmware screens it, then the root keeps it and
+ * anyone else forwards it to its parent */
+static void
+dao_hop(node_t *n, uint32_t f)
+{
+  frame_t *fr = &frames[f];
+  enum netstack_ip_action action;
+
+  if((opt.loss > 0 && rng_unit() < opt.loss) ||
+     (!n->is_root && n->parent < 0)) {
+    dao.lost++;
+    frame_release(f);
+    return;
+  }
+  switch_to(n);
+  sim_rx_rssi = 0;
+  sim_rx_lqi = 0;
+  memcpy(uip_buf, fr->data, fr->len);
+  uip_len = fr->len;
+  uip_ext_len = 0;
+  action = sim_processor != NULL ? sim_processor->process_input() :
+    NETSTACK_IP_PROCESS;
+
+  if(n->is_root) {
+    if(fr->replay) {
+      dao.rx_replay++;
+      dao.drop_replay += action == NETSTACK_IP_DROP;
+    } else {
+      dao.rx_genuine++;
+      dao.drop_genuine += action == NETSTACK_IP_DROP;
+    }
+    frame_release(f);
+  } else if(action == NETSTACK_IP_DROP) {
+    dao.fwd_drops++;
+    frame_release(f);
+  } else {
+    send_dao(n, f, &nodes[n->nbr_node[n->parent]]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Where an attacker injects a DAO: its best-ranked joined neighbor */
+static node_t *
+attacker_uplink(node_t *a)
+{
+  node_t *best = NULL;
+  int k;
+
+  for(k = 0; k < a->n_nbrs; k++) {
+    node_t *to = &nodes[a->nbr_node[k]];
+    if(!to->is_attacker && to->joined &&
+       (best == NULL || to->rank < best->rank)) {
+      best = to;
+    }
+  }
+  return best;
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+trickle_interval(node_t *n)
+{
+  return (uint64_t)1 << (DIO_INTERVAL_MIN + n->doublings);
+}
+/*---------------------------------------------------------------------------*/
+static void
+trickle_start_interval(node_t *n)
+{
+  uint64_t i = trickle_interval(n);
+
+  n->interval_start = now;
+  n->heard = 0;
+  schedule(now + i / 2 + (uint64_t)(rng_unit() * (i / 2)), EV_TRICKLE_TX,
+           n, NULL);
+  schedule(now + i, EV_TRICKLE_END, n, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle(const event_t *ev)
+{
+  node_t *n = &nodes[ev->node];
+  node_t *uplink;
+  int i, j;
+
+  switch(ev->type) {
+  case EV_BOOT:
+    /* The root only screens DAOs, so it runs the firmware only for them */
+    if((!n->is_root || opt.dao_interval > 0) && !n->is_attacker) {
+      switch_to(n);
+      run_process(PROCESS_EVENT_INIT, NULL);
+    }
+    if(n->joined) {
+      trickle_start_interval(n);
+    }
+    if(n->joined && !n->is_root && opt.dao_interval > 0) {
+      n->dao_seq = RPL_LOLLIPOP_INIT;
+      schedule(now + (uint64_t)(rng_unit() * opt.dao_interval * 1000),
+               EV_DAO, n, NULL);
+    }
+    if(n->is_attacker) {
+      schedule((uint64_t)opt.attack_start * 1000, EV_ATTACK, n, NULL);
+    }
+    break;
+  case EV_TIMER:
+    switch_to(n);
+    /* Stale if the timer was re-armed since this event was queued */
+    if(ev->u.et->active && ev->u.et->start + ev->u.et->interval == now) {
+      ev->u.et->active = 0;
+      timer_wakeups += !n->is_root;
+      run_process(PROCESS_EVENT_TIMER, ev->u.et);
+    }
+    break;
+  case EV_POLL:
+    switch_to(n);
+    n->poll_pending = 0;
+    run_process(PROCESS_EVENT_POLL, NULL);
+    break;
+  case EV_TRICKLE_TX:
+#if DIO_REDUNDANCY
+    if(n->heard >= DIO_REDUNDANCY) {
+      break;
+    }
+#endif
+    transmit(n, emit_dio(n), now + 1);
+    break;
+  case EV_TRICKLE_END:
+    if(n->doublings < DIO_INTERVAL_DOUBLINGS) {
+      n->doublings++;
+    }
+    trickle_start_interval(n);
+    break;
+  case EV_DELIVER:
+    deliver(n, ev->u.frame);
+    break;
+  case EV_ATTACK:
+    for(i = 0; i < n->cap_count; i++) {
+      for(j = 0; j < (int)opt.replay_count; j++) {
+        uint32_t f = frame_alloc();
+        frames[f] = frames[n->captured[i]];
+        transmit(n, f, now + 1 + i * opt.replay_count + j);
+      }
+    }
+    uplink = attacker_uplink(n);
+    for(i = 0; uplink != NULL && i < n->dao_cap_count; i++) {
+      for(j = 0; j < (int)opt.replay_count; j++) {
+        uint32_t f = frame_alloc();
+        frames[f] = frames[n->dao_captured[i]];
+        send_dao(n, f, uplink);
+        dao.replay_tx++;
+      }
+    }
+    schedule(now + (uint64_t)opt.attack_interval * 1000, EV_ATTACK, n, NULL);
+    break;
+  case EV_DAO:
+    send_dao(n, emit_dao(n), &nodes[n->nbr_node[n->parent]]);
+    dao.tx++;
+    schedule(now + (uint64_t)opt.dao_interval * 1000, EV_DAO, n, NULL);
+    break;
+  case EV_DAO_HOP:
+    dao_hop(n, ev->u.frame);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+cmp_u64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_summary(double wall)
+{
+  uint64_t rx_g = 0, rx_r = 0, drop_g = 0, drop_r = 0;
+  uint64_t *lat = xmalloc(n_nodes * sizeof(uint64_t));
+  unsigned exposed = 0, detected = 0, protected = 0, joined = 0;
+  unsigned i;
+  double precision, recall;
+
+  for(i = 0; i < n_nodes; i++) {
+    node_t *n = &nodes[i];
+    if(n->is_root || n->is_attacker) {
+      continue;
+    }
+    protected++;
+    joined += n->joined;
+    rx_g += n->rx_genuine;
+    rx_r += n->rx_replay;
+    drop_g += n->drop_genuine;
+    drop_r += n->drop_replay;
+    if(n->rx_replay > 0) {
+      exposed++;
+      if(n->first_replay_drop > 0) {
+        lat[detected++] = n->first_replay_drop - n->first_replay_rx;
+      }
+    }
+  }
+  qsort(lat, detected, sizeof(uint64_t), cmp_u64);
+  precision = drop_g + drop_r > 0 ? 100.0 * drop_r / (drop_g + drop_r) : 0;
+  recall = rx_r > 0 ? 100.0 * drop_r / rx_r : 0;
+
+  printf("════════════════════════════════════════════\n");
+  printf("Nodes:            %u protected (%u joined), %u attacker(s)\n",
+         protected, joined, opt.attackers);
+  printf("Simulated:        %u s, seed %lu\n", opt.duration, opt.seed);
+  printf("DIOs sent:        %lu genuine, %lu replayed\n",
+         (unsigned long)dio_tx, (unsigned long)replay_tx);
+  printf("Receptions:       %lu genuine, %lu replayed\n",
+         (unsigned long)rx_g, (unsigned long)rx_r);
+  printf("Dropped:          %lu replayed (TP), %lu genuine (FP)\n",
+         (unsigned long)drop_r, (unsigned long)drop_g);
+  printf("Accepted:         %lu genuine (TN), %lu replayed (FN)\n",
+         (unsigned long)(rx_g - drop_g), (unsigned long)(rx_r - drop_r));
+  printf("Precision/recall: %.1f%% / %.1f%%\n", precision, recall);
+  printf("Detecting nodes:  %u of %u exposed\n", detected, exposed);
+  if(detected > 0) {
+    printf("Latency (ms):     min %lu, median %lu, max %lu\n",
+           (unsigned long)lat[0], (unsigned long)lat[detected / 2],
+           (unsigned long)lat[detected - 1]);
+  }
+  printf("Blacklistings:    %lu", (unsigned long)blacklist_events);
+  if(first_blacklist != UINT64_MAX && first_replay_tx != UINT64_MAX) {
+    printf(", first %.1f s after the first replay",
+           ((double)first_blacklist - (double)first_replay_tx) / 1000);
+  }
+  printf("\n");
+  printf("Timer wakeups:    %.1f per node per hour\n",
+         protected > 0 && opt.duration > 0 ?
+         (double)timer_wakeups * 3600 / protected / opt.duration : 0);
+  if(opt.dao_interval > 0) {
+    printf("DAOs sent:        %lu genuine, %lu replayed\n",
+           (unsigned long)dao.tx, (unsigned long)dao.replay_tx);
+    printf("DAOs at root:     %lu/%lu replayed dropped, %lu/%lu genuine dropped\n",
+           (unsigned long)dao.drop_replay, (unsigned long)dao.rx_replay,
+           (unsigned long)dao.drop_genuine, (unsigned long)dao.rx_genuine);
+    printf("DAOs on the way:  %lu dropped by forwarders, %lu lost\n",
+           (unsigned long)dao.fwd_drops, (unsigned long)dao.lost);
+  }
+  printf("Events:           %lu in %.2f s wall (%.0f/s), %zu B state/node\n",
+         (unsigned long)events_run, wall, wall > 0 ? events_run / wall : 0,
+         data_size + bss_size);
+  printf("════════════════════════════════════════════\n");
+  printf("[SIM] %u,%u,%lu,%u,%lu,%lu,%lu,%lu,%u,%u,%lu\n",
+         protected, opt.attackers, opt.seed, opt.duration,
+         (unsigned long)drop_r, (unsigned long)drop_g,
+         (unsigned long)(rx_g - drop_g), (unsigned long)(rx_r - drop_r),
+         detected, exposed,
+         (unsigned long)(detected > 0 ? lat[detected / 2] : 0));
+  if(opt.dao_interval > 0) {
+    printf("[DAO] %lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+           (unsigned long)dao.tx, (unsigned long)dao.replay_tx,
+           (unsigned long)dao.drop_replay, (unsigned long)dao.drop_genuine,
+           (unsigned long)(dao.rx_genuine - dao.drop_genuine),
+           (unsigned long)(dao.rx_replay - dao.drop_replay),
+           (unsigned long)dao.fwd_drops);
+  }
+  free(lat);
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(void)
+{
+  fprintf(stderr,
+          "usage: dessim [options]\n"
+          "  --nodes N            protected nodes incl. the root (100)\n"
+          "  --attackers K        replaying attackers (1)\n"
+          "  --degree D           mean radio neighbors (8)\n"
+          "  --range M            radio range in metres (50)\n"
+          "  --duration S         simulated seconds (3600)\n"
+          "  --seed N             random seed (123456)\n"
+          "  --loss P             per-link frame loss probability (0)\n"
+          "  --attack-start S     first replay burst (60)\n"
+          "  --attack-interval S  seconds between bursts (10)\n"
+          "  --replay-count N     copies of each captured DIO per burst (5)\n"
+          "  --dao-interval S     send DAOs every S seconds, 0 for none (0)\n"
+          "  --log FILE           write mote output in Cooja format\n"
+          "  --log-level L        none|err|warn|info|dbg (warn)\n");
+  exit(2);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  static const struct option longopts[] = {
+    { "nodes", required_argument, NULL, 'n' },
+    { "attackers", required_argument, NULL, 'a' },
+    { "degree", required_argument, NULL, 'd' },
+    { "range", required_argument, NULL, 'r' },
+    { "duration", required_argument, NULL, 't' },
+    { "seed", required_argument, NULL, 's' },
+    { "loss", required_argument, NULL, 'l' },
+    { "attack-start", required_argument, NULL, 'A' },
+    { "attack-interval", required_argument, NULL, 'I' },
+    { "replay-count", required_argument, NULL, 'R' },
+    { "dao-interval", required_argument, NULL, 'D' },
+    { "log", required_argument, NULL, 'o' },
+    { "log-level", required_argument, NULL, 'L' },
+    { NULL, 0, NULL, 0 }
+  };
+  static const char *levels[] = { "none", "err", "warn", "info", "dbg" };
+  struct timespec t0, t1;
+  uint64_t end;
+  unsigned i;
+  int c;
+
+  while((c = getopt_long(argc, argv, "", longopts, NULL)) != -1) {
+    switch(c) {
+    case 'n': opt.nodes = strtoul(optarg, NULL, 0); break;
+    case 'a': opt.attackers = strtoul(optarg, NULL, 0); break;
+    case 'd': opt.degree = atof(optarg); break;
+    case 'r': opt.range = atof(optarg); break;
+    case 't': opt.duration = strtoul(optarg, NULL, 0); break;
+    case 's': opt.seed = strtoul(optarg, NULL, 0); break;
+    case 'l': opt.loss = atof(optarg); break;
+    case 'A': opt.attack_start = strtoul(optarg, NULL, 0); break;
+    case 'I': opt.attack_interval = strtoul(optarg, NULL, 0); break;
+    case 'R': opt.replay_count = strtoul(optarg, NULL, 0); break;
+    case 'D': opt.dao_interval = strtoul(optarg, NULL, 0); break;
+    case 'o': opt.log_path = optarg; break;
+    case 'L':
+      for(i = 0; i < 5 && strcmp(optarg, levels[i]) != 0; i++);
+      if(i == 5) {
+        usage();
+      }
+      opt.log_level = i;
+      break;
+    default:
+      usage();
+    }
+  }
+  if(opt.nodes < 2 || opt.degree <= 0 || opt.range <= 0 ||
+     opt.attack_interval == 0) {
+    usage();
+  }
+
+  if(opt.log_path != NULL) {
+    log_file = fopen(opt.log_path, "w");
+    if(log_file == NULL) {
+      perror(opt.log_path);
+      return 1;
+    }
+  }
+  /* Blacklisting lines are WARN; always format them for the counters */
+  sim_log_level = opt.log_level > LOG_LEVEL_WARN ? opt.log_level :
+    LOG_LEVEL_WARN;
+
+  data_size = __stop_mit_data - __start_mit_data;
+  bss_size = __stop_mit_bss - __start_mit_bss;
+  pristine_data = xmalloc(data_size);
+  memcpy(pristine_data, __start_mit_data, data_size);
+
+  rng_state = opt.seed * 0x9E3779B97F4A7C15ULL + 1;
+  build_topology();
+  for(i = 0; i < n_nodes; i++) {
+    schedule((uint64_t)(rng_unit() * 1000), EV_BOOT, &nodes[i], NULL);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  end = (uint64_t)opt.duration * 1000;
+  while(heap_len > 0 && heap[0].time <= end) {
+    event_t ev = pop_event();
+    now = ev.time;
+    handle(&ev);
+    events_run++;
+  }
+  shim_log_flush();
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  print_summary((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+  if(log_file != NULL) {
+    fclose(log_file);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,40 @@
+/*
+ * Services the simulator core provides to the Contiki shim.
+ */
+#ifndef DESSIM_H_
+#define DESSIM_H_
+
+#include "shim.h"
+
+/* Current simulated time in milliseconds */
+uint64_t sim_now(void);
+
+/* Deliver PROCESS_EVENT_TIMER to the current node when et expires at 'at' */
+void sim_schedule_timer(struct etimer *et, uint64_t at);
+
+/* Deliver PROCESS_EVENT_POLL to the current node as soon as possible */
+void sim_schedule_poll(void);
+
+/* Deterministic per-run random stream */
+uint16_t sim_random(void);
+
+/* Neighbor table of the current node */
+rpl_nbr_t *sim_neighbors(int *count);
+
+/* One complete log line from the current node, without the newline */
+void sim_log_line(int level, const char *line);
+
+/* Highest level that reaches sim_log_line() */
+extern int sim_log_level;
+
+/* Packet processor registered by the firmware (same address on every node) */
+extern struct netstack_ip_packet_processor *sim_processor;
+
+/* RSSI (dBm) and LQI of the frame being delivered to the current node */
+extern int16_t sim_rx_rssi;
+extern uint8_t sim_rx_lqi;
+
+/* Emit a partial log line left by the current node, before switching nodes */
+void shim_log_flush(void);
+
+#endif /* DESSIM_H_ */
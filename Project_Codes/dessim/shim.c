@@ -0,0 +1,429 @@
+/*
+ * Contiki-NG API on top of the discrete-event simulator. The firmware
+ * state itself is swapped per node by the core; everything here either
+ * reads the current node's view or forwards to the core.
+ */
+#include "dessim.h"
+#include <stdarg.h>
+
+uint8_t uip_buf[UIP_BUFSIZE];
+uint16_t uip_len;
+uint16_t uip_ext_len;
+linkaddr_t linkaddr_node_addr;
+rpl_instance_t curr_instance;
+struct netstack_ip_packet_processor *sim_processor;
+int16_t sim_rx_rssi;
+uint8_t sim_rx_lqi;
+int sim_log_level = LOG_LEVEL_WARN;
+
+/* Log line being assembled for the current node */
+static char log_buf[512];
+static int log_pos;
+static int log_line_level;
+
+/*---------------------------------------------------------------------------*/
+clock_time_t
+clock_time(void)
+{
+  return (clock_time_t)sim_now();
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+clock_seconds(void)
+{
+  return (unsigned long)(sim_now() / 1000);
+}
+/*---------------------------------------------------------------------------*/
+rtimer_clock_t
+rtimer_now_fn(void)
+{
+  /* Virtual time does not advance while firmware code runs */
+  return (rtimer_clock_t)(sim_now() * RTIMER_SECOND / 1000);
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_set(struct etimer *et, clock_time_t interval)
+{
+  et->start = clock_time();
+  et->interval = interval;
+  et->active = 1;
+  sim_schedule_timer(et, et->start + et->interval);
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_reset(struct etimer *et)
+{
+  et->start += et->interval;
+  et->active = 1;
+  sim_schedule_timer(et, et->start + et->interval);
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_reset_with_new_interval(struct etimer *et, clock_time_t interval)
+{
+  et->interval = interval;
+  etimer_reset(et);
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_restart(struct etimer *et)
+{
+  etimer_set(et, et->interval);
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_stop(struct etimer *et)
+{
+  et->active = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+etimer_expired(struct etimer *et)
+{
+  return !et->active;
+}
+/*---------------------------------------------------------------------------*/
+void
+process_poll(struct process *p)
+{
+  sim_schedule_poll();
+}
+/*---------------------------------------------------------------------------*/
+void
+random_init(unsigned short seed)
+{
+  /* The run seed alone decides the random stream */
+}
+/*---------------------------------------------------------------------------*/
+unsigned short
+random_rand(void)
+{
+  return sim_random();
+}
+/*---------------------------------------------------------------------------*/
+void
+memb_init(struct memb *m)
+{
+  memset(m->used, 0, m->num);
+  memset(m->mem, 0, (size_t)m->size * m->num);
+}
+/*---------------------------------------------------------------------------*/
+void *
+memb_alloc(struct memb *m)
+{
+  int i;
+
+  for(i = 0; i < m->num; i++) {
+    if(!m->used[i]) {
+      m->used[i] = 1;
+      return (char *)m->mem + (size_t)i * m->size;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+memb_free(struct memb *m, void *ptr)
+{
+  size_t i = ((char *)ptr - (char *)m->mem) / m->size;
+
+  if(i >= m->num) {
+    return -1;
+  }
+  m->used[i] = 0;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+struct list { struct list *next; };
+
+void
+list_init(list_t list)
+{
+  *list = NULL;
+}
+/*---------------------------------------------------------------------------*/
+void *
+list_head(list_t list)
+{
+  return *list;
+}
+/*---------------------------------------------------------------------------*/
+void
+list_remove(list_t list, const void *item)
+{
+  struct list **l;
+
+  for(l = (struct list **)list; *l != NULL; l = &(*l)->next) {
+    if(*l == item) {
+      *l = (*l)->next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+list_add(list_t list, void *item)
+{
+  struct list **l;
+
+  /* Appended at the tail, moved there if already listed */
+  list_remove(list, item);
+  ((struct list *)item)->next = NULL;
+  for(l = (struct list **)list; *l != NULL; l = &(*l)->next);
+  *l = item;
+}
+/*---------------------------------------------------------------------------*/
+void *
+list_item_next(const void *item)
+{
+  return item == NULL ? NULL : ((const struct list *)item)->next;
+}
+/*---------------------------------------------------------------------------*/
+int
+uipbuf_set_len(uint16_t len)
+{
+  if(len > UIP_BUFSIZE) {
+    return 0;
+  }
+  uip_len = len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Upper-layer header past the extension-header chain, or NULL if the
+ * chain runs out of the buffer */
+uint8_t *
+uipbuf_get_last_header(uint8_t *buffer, uint16_t size, uint8_t *protocol)
+{
+  uint16_t pos = UIP_IPH_LEN;
+
+  if(size < UIP_IPH_LEN) {
+    return NULL;
+  }
+  *protocol = ((struct uip_ip_hdr *)buffer)->proto;
+  while(*protocol == UIP_PROTO_HBHO || *protocol == UIP_PROTO_ROUTING ||
+        *protocol == UIP_PROTO_FRAG || *protocol == UIP_PROTO_DESTO) {
+    if(pos + 2 > size) {
+      return NULL;
+    }
+    *protocol = buffer[pos];
+    pos += (buffer[pos + 1] + 1) * 8;
+  }
+  return pos < size ? buffer + pos : NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_ds6_is_my_addr(const uip_ipaddr_t *addr)
+{
+  static const uint8_t zero[6];
+  uint8_t iid[8];
+
+  memcpy(iid, linkaddr_node_addr.u8, sizeof(iid));
+  iid[0] ^= 0x02;
+  return ((addr->u8[0] == 0xfe && addr->u8[1] == 0x80) ||
+          (addr->u8[0] == 0xfd && addr->u8[1] == 0x00)) &&
+    memcmp(&addr->u8[2], zero, sizeof(zero)) == 0 &&
+    memcmp(&addr->u8[8], iid, sizeof(iid)) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+chksum_add(uint32_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t i;
+
+  for(i = 0; i + 1 < len; i += 2) {
+    sum += (data[i] << 8) | data[i + 1];
+  }
+  if(len & 1) {
+    sum += data[len - 1] << 8;
+  }
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_icmp6chksum(void)
+{
+  uint16_t upper_len = ((UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]) -
+    uip_ext_len;
+  uint32_t sum = upper_len + UIP_PROTO_ICMP6;
+  uint16_t result;
+
+  sum = chksum_add(sum, UIP_IP_BUF->srcipaddr.u8, 2 * sizeof(uip_ipaddr_t));
+  sum = chksum_add(sum, &uip_buf[UIP_IPH_LEN + uip_ext_len], upper_len);
+  while(sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  result = sum == 0 ? 0xffff : sum;
+  /* Network byte order in memory, like uip_htons() on the real stack */
+  return (uint16_t)((result >> 8) | (result << 8));
+}
+/*---------------------------------------------------------------------------*/
+int
+simple_udp_register(struct simple_udp_connection *c, uint16_t local_port,
+                    uip_ipaddr_t *remote_addr, uint16_t remote_port,
+                    simple_udp_callback receive_callback)
+{
+  c->local_port = local_port;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+simple_udp_sendto(struct simple_udp_connection *c, const void *data,
+                  uint16_t datalen, const uip_ipaddr_t *to)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+netstack_ip_packet_processor_add(struct netstack_ip_packet_processor *p)
+{
+  sim_processor = p;
+}
+/*---------------------------------------------------------------------------*/
+packetbuf_attr_t
+packetbuf_attr(uint8_t type)
+{
+  switch(type) {
+  case PACKETBUF_ATTR_RSSI:
+    return (packetbuf_attr_t)sim_rx_rssi;
+  case PACKETBUF_ATTR_LINK_QUALITY:
+    return sim_rx_lqi;
+  default:
+    return 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+rpl_nbr_t *
+rpl_neighbor_get_from_ipaddr(uip_ipaddr_t *addr)
+{
+  int count;
+  int i;
+  rpl_nbr_t *nbrs = sim_neighbors(&count);
+
+  for(i = 0; i < count; i++) {
+    if(uip_ipaddr_cmp(&nbrs[i].ipaddr, addr)) {
+      return &nbrs[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+uip_ipaddr_t *
+rpl_neighbor_get_ipaddr(rpl_nbr_t *nbr)
+{
+  return nbr != NULL ? &nbr->ipaddr : NULL;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+rpl_neighbor_get_link_metric(rpl_nbr_t *nbr)
+{
+  return nbr != NULL ? nbr->link_metric : 0xffff;
+}
+/*---------------------------------------------------------------------------*/
+void
+energest_flush(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+uint64_t
+energest_type_time(int type)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+log_append(const char *fmt, va_list ap)
+{
+  int n;
+
+  n = vsnprintf(log_buf + log_pos, sizeof(log_buf) - log_pos, fmt, ap);
+  if(n > 0) {
+    log_pos += n;
+    if(log_pos >= (int)sizeof(log_buf)) {
+      log_pos = sizeof(log_buf) - 1;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+log_append_str(const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  log_append(fmt, ap);
+  va_end(ap);
+}
+/*---------------------------------------------------------------------------*/
+static void
+log_emit_lines(void)
+{
+  char *start = log_buf;
+  char *nl;
+
+  while((nl = memchr(start, '\n', log_buf + log_pos - start)) != NULL) {
+    *nl = '\0';
+    sim_log_line(log_line_level, start);
+    start = nl + 1;
+  }
+  log_pos -= start - log_buf;
+  memmove(log_buf, start, log_pos);
+  log_buf[log_pos] = '\0';
+}
+/*---------------------------------------------------------------------------*/
+void
+shim_log(int level, const char *module, int prefix, const char *fmt, ...)
+{
+  static const char *names[] = { "NONE", "ERR", "WARN", "INFO", "DBG" };
+  va_list ap;
+
+  if(level > sim_log_level) {
+    return;
+  }
+  if(prefix) {
+    log_line_level = level;
+    log_append_str("[%s: %-10s] ", names[level], module);
+  }
+  va_start(ap, fmt);
+  log_append(fmt, ap);
+  va_end(ap);
+  log_emit_lines();
+}
+/*---------------------------------------------------------------------------*/
+void
+shim_log_6addr(int level, const uip_ipaddr_t *addr)
+{
+  int best = -1, best_len = 0;
+  int i, j;
+
+  if(level > sim_log_level) {
+    return;
+  }
+  /* Longest run of zero groups collapses to "::", as uiplib does */
+  for(i = 0; i < 8; i = j + 1) {
+    for(j = i; j < 8 && addr->u8[2 * j] == 0 && addr->u8[2 * j + 1] == 0; j++);
+    if(j - i > best_len && j - i > 1) {
+      best = i;
+      best_len = j - i;
+    }
+  }
+  for(i = 0; i < 8; i++) {
+    if(i == best) {
+      log_append_str("::");
+      i += best_len - 1;
+      continue;
+    }
+    log_append_str("%s%x", i > 0 && i != best + best_len ? ":" : "",
+                   (addr->u8[2 * i] << 8) | addr->u8[2 * i + 1]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+shim_log_flush(void)
+{
+  if(log_pos > 0) {
+    sim_log_line(log_line_level, log_buf);
+    log_pos = 0;
+    log_buf[0] = '\0';
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,2 @@
+/* Resolved by the simulator shim, see shim.h */
+#include "shim.h"
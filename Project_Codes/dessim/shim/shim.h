@@ -0,0 +1,308 @@
+/*
+ * Host-side stand-in for the parts of Contiki-NG that
+ * rpl-dio-replay-mitigation.c uses. Every header the firmware includes
+ * resolves to this file; the definitions live in shim.c and read the
+ * simulator's clock and the current virtual node's RPL view.
+ */
+#ifndef SHIM_H_
+#define SHIM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*---------------------------------------------------------------------------*/
+/* Clock and timers */
+typedef unsigned long clock_time_t;
+#define CLOCK_SECOND 1000UL /* Simulator time is kept in milliseconds */
+clock_time_t clock_time(void);
+unsigned long clock_seconds(void);
+
+struct etimer {
+  clock_time_t start;
+  clock_time_t interval;
+  uint8_t active;
+};
+void etimer_set(struct etimer *et, clock_time_t interval);
+void etimer_reset(struct etimer *et);
+void etimer_reset_with_new_interval(struct etimer *et, clock_time_t interval);
+void etimer_restart(struct etimer *et);
+void etimer_stop(struct etimer *et);
+int etimer_expired(struct etimer *et);
+
+typedef uint32_t rtimer_clock_t;
+#define RTIMER_SECOND 32768UL
+rtimer_clock_t rtimer_now_fn(void);
+#define RTIMER_NOW() rtimer_now_fn()
+
+/*---------------------------------------------------------------------------*/
+/* Protothreads and processes, same local-continuation scheme as Contiki */
+typedef unsigned short lc_t;
+struct pt { lc_t lc; };
+#define PT_YIELDED 1
+#define PT_ENDED 3
+#define PT_THREAD(name_args) char name_args
+#define PT_INIT(pt) ((pt)->lc = 0)
+#define PT_BEGIN(pt) { char PT_YIELD_FLAG = 1; if(PT_YIELD_FLAG) {;} \
+  switch((pt)->lc) { case 0:
+#define PT_END(pt) } PT_YIELD_FLAG = 0; PT_INIT(pt); return PT_ENDED; }
+#define PT_YIELD(pt) do { PT_YIELD_FLAG = 0; (pt)->lc = __LINE__; \
+  case __LINE__: if(PT_YIELD_FLAG == 0) { return PT_YIELDED; } } while(0)
+
+typedef unsigned char process_event_t;
+typedef void *process_data_t;
+#define PROCESS_EVENT_INIT 0x81
+#define PROCESS_EVENT_POLL 0x82
+#define PROCESS_EVENT_TIMER 0x88
+
+struct process {
+  struct process *next;
+  const char *name;
+  PT_THREAD((*thread)(struct pt *, process_event_t, process_data_t));
+  struct pt pt;
+};
+
+#define PROCESS_NAME(name) extern struct process name
+#define PROCESS_THREAD(name, ev, data) \
+  static PT_THREAD(process_thread_##name(struct pt *process_pt, \
+                                         process_event_t ev, \
+                                         process_data_t data))
+#define PROCESS(name, strname) \
+  PROCESS_THREAD(name, ev, data); \
+  struct process name = { NULL, strname, process_thread_##name, { 0 } }
+#define AUTOSTART_PROCESSES(...) \
+  struct process *const autostart_processes[] = { __VA_ARGS__, NULL }
+#define PROCESS_BEGIN() PT_BEGIN(process_pt)
+#define PROCESS_END() PT_END(process_pt)
+#define PROCESS_YIELD() PT_YIELD(process_pt)
+#define PROCESS_WAIT_EVENT() PROCESS_YIELD()
+
+void process_poll(struct process *p);
+
+void random_init(unsigned short seed);
+unsigned short random_rand(void);
+#define RANDOM_RAND_MAX 65535U
+
+/*---------------------------------------------------------------------------*/
+/* Block pools and linked lists, same layout rules as Contiki's */
+struct memb {
+  unsigned short size;
+  unsigned short num;
+  char *used;
+  void *mem;
+};
+#define MEMB(name, structure, num) \
+  static char name##_memb_count[num]; \
+  static structure name##_memb_mem[num]; \
+  static struct memb name = { sizeof(structure), num, \
+                              name##_memb_count, (void *)name##_memb_mem }
+void memb_init(struct memb *m);
+void *memb_alloc(struct memb *m);
+int memb_free(struct memb *m, void *ptr);
+
+/* List items start with a "next" pointer */
+typedef void **list_t;
+#define LIST(name) \
+  static void *name##_list = NULL; \
+  static list_t name = (list_t)&name##_list
+void list_init(list_t list);
+void *list_head(list_t list);
+void list_add(list_t list, void *item);
+void list_remove(list_t list, const void *item);
+void *list_item_next(const void *item);
+
+/*---------------------------------------------------------------------------*/
+/* Addresses and the IPv6 packet buffer */
+#define LINKADDR_SIZE 8
+typedef union { uint8_t u8[LINKADDR_SIZE]; uint16_t u16[LINKADDR_SIZE / 2]; } linkaddr_t;
+extern linkaddr_t linkaddr_node_addr;
+
+typedef union { uint8_t u8[16]; uint16_t u16[8]; } uip_ip6addr_t;
+typedef uip_ip6addr_t uip_ipaddr_t;
+#define uip_ipaddr_cmp(a, b) (memcmp(a, b, sizeof(uip_ipaddr_t)) == 0)
+#define uip_ipaddr_copy(dst, src) (*(dst) = *(src))
+#define uip_is_addr_unspecified(a) \
+  ((a)->u16[0] == 0 && (a)->u16[1] == 0 && (a)->u16[2] == 0 && \
+   (a)->u16[3] == 0 && (a)->u16[4] == 0 && (a)->u16[5] == 0 && \
+   (a)->u16[6] == 0 && (a)->u16[7] == 0)
+#define uip_is_addr_mcast(a) ((a)->u8[0] == 0xFF)
+
+#define UIP_BUFSIZE 1280
+#define UIP_IPH_LEN 40
+#define UIP_ICMPH_LEN 4
+#define UIP_PROTO_ICMP6 58
+#define UIP_PROTO_HBHO 0
+#define UIP_PROTO_ROUTING 43
+#define UIP_PROTO_FRAG 44
+#define UIP_PROTO_DESTO 60
+#define ICMP6_RPL 155
+
+struct uip_ip_hdr {
+  uint8_t vtc, tcflow;
+  uint16_t flow;
+  uint8_t len[2];
+  uint8_t proto, ttl;
+  uip_ip6addr_t srcipaddr, destipaddr;
+};
+struct uip_icmp_hdr {
+  uint8_t type, icode;
+  uint16_t icmpchksum;
+};
+
+extern uint8_t uip_buf[UIP_BUFSIZE];
+extern uint16_t uip_len;
+extern uint16_t uip_ext_len;
+#define UIP_IP_BUF ((struct uip_ip_hdr *)uip_buf)
+int uipbuf_set_len(uint16_t len);
+uint8_t *uipbuf_get_last_header(uint8_t *buffer, uint16_t size,
+                                uint8_t *protocol);
+/* fe80::/64 and fd00::/64 on the current node's link address */
+int uip_ds6_is_my_addr(const uip_ipaddr_t *addr);
+uint16_t uip_icmp6chksum(void);
+
+struct simple_udp_connection { uint16_t local_port; };
+typedef void (*simple_udp_callback)(struct simple_udp_connection *c,
+                                    const uip_ipaddr_t *source_addr,
+                                    uint16_t source_port,
+                                    const uip_ipaddr_t *dest_addr,
+                                    uint16_t dest_port,
+                                    const uint8_t *data, uint16_t datalen);
+int simple_udp_register(struct simple_udp_connection *c, uint16_t local_port,
+                        uip_ipaddr_t *remote_addr, uint16_t remote_port,
+                        simple_udp_callback receive_callback);
+int simple_udp_sendto(struct simple_udp_connection *c, const void *data,
+                      uint16_t datalen, const uip_ipaddr_t *to);
+
+/*---------------------------------------------------------------------------*/
+/* Netstack hook the mitigation taps into */
+enum netstack_ip_action { NETSTACK_IP_PROCESS = 0, NETSTACK_IP_DROP = 1 };
+struct netstack_ip_packet_processor {
+  struct netstack_ip_packet_processor *next;
+  enum netstack_ip_action (*process_input)(void);
+  enum netstack_ip_action (*process_output)(const linkaddr_t *localdest);
+};
+void netstack_ip_packet_processor_add(struct netstack_ip_packet_processor *p);
+
+/* Radio metadata of the frame being delivered */
+#define PACKETBUF_ATTR_RSSI 0
+#define PACKETBUF_ATTR_LINK_QUALITY 1
+typedef uint16_t packetbuf_attr_t;
+packetbuf_attr_t packetbuf_attr(uint8_t type);
+
+/*---------------------------------------------------------------------------*/
+/* RPL Lite view of the current node */
+typedef uint16_t rpl_rank_t;
+#define RPL_INFINITE_RANK 0xffff
+#define RPL_OPTION_PAD1 0
+#define RPL_OPTION_PADN 1
+#define RPL_OPTION_DAG_CONF 4
+#define RPL_CODE_DIS 0x00
+#define RPL_CODE_DIO 0x01
+#define RPL_CODE_DAO 0x02
+#define RPL_CODE_DAO_ACK 0x03
+#define RPL_LOLLIPOP_MAX_VALUE 255
+#define RPL_LOLLIPOP_CIRCULAR_REGION 127
+#define RPL_LOLLIPOP_SEQUENCE_WINDOWS 16
+#define RPL_LOLLIPOP_INIT (RPL_LOLLIPOP_MAX_VALUE - RPL_LOLLIPOP_SEQUENCE_WINDOWS + 1)
+#define RPL_LOLLIPOP_INCREMENT(counter) \
+  do { \
+    if((counter) > RPL_LOLLIPOP_CIRCULAR_REGION) { \
+      (counter) = ((counter) + 1) & RPL_LOLLIPOP_MAX_VALUE; \
+    } else { \
+      (counter) = ((counter) + 1) & RPL_LOLLIPOP_CIRCULAR_REGION; \
+    } \
+  } while(0)
+#define RPL_LOLLIPOP_GREATER_THAN_LOCAL(A, B) \
+  (((A) < (B)) && ((RPL_LOLLIPOP_MAX_VALUE + 1 + (A) - (B)) < RPL_LOLLIPOP_SEQUENCE_WINDOWS)) || \
+  (((A) > (B)) && (((A) - (B)) < (RPL_LOLLIPOP_SEQUENCE_WINDOWS + 1)))
+#define RPL_LOLLIPOP_GREATER_THAN(A, B) \
+  ((((A) > RPL_LOLLIPOP_CIRCULAR_REGION) && ((B) <= RPL_LOLLIPOP_CIRCULAR_REGION)) ? \
+   (RPL_LOLLIPOP_CIRCULAR_REGION + 1 + (B) - (A) > RPL_LOLLIPOP_SEQUENCE_WINDOWS) : \
+   ((((A) <= RPL_LOLLIPOP_CIRCULAR_REGION) && ((B) > RPL_LOLLIPOP_CIRCULAR_REGION)) ? \
+    (RPL_LOLLIPOP_CIRCULAR_REGION + 1 + (A) - (B) <= RPL_LOLLIPOP_SEQUENCE_WINDOWS) : \
+    (RPL_LOLLIPOP_GREATER_THAN_LOCAL(A, B))))
+
+enum rpl_dag_state { DAG_INITIALIZED, DAG_JOINED, DAG_REACHABLE, DAG_POISONING };
+
+typedef struct rpl_nbr {
+  uip_ipaddr_t ipaddr;
+  rpl_rank_t rank;
+  uint16_t link_metric;
+} rpl_nbr_t;
+
+/* Objective function; the core picks parents itself, so no instance has one */
+typedef struct rpl_of {
+  void (*reset)(void);
+  int (*nbr_is_acceptable_parent)(rpl_nbr_t *nbr);
+  uint16_t (*nbr_link_metric)(rpl_nbr_t *nbr);
+  int (*nbr_has_usable_link)(rpl_nbr_t *nbr);
+  uint16_t (*nbr_path_cost)(rpl_nbr_t *nbr);
+  rpl_rank_t (*rank_via_nbr)(rpl_nbr_t *nbr);
+  rpl_nbr_t *(*best_parent)(rpl_nbr_t *nbr1, rpl_nbr_t *nbr2);
+  void (*update_metric_container)(void);
+  uint8_t ocp;
+} rpl_of_t;
+
+typedef struct {
+  rpl_nbr_t *preferred_parent;
+  rpl_rank_t rank;
+  uint8_t version;
+  uip_ipaddr_t dag_id;
+  enum rpl_dag_state state;
+  uint8_t dio_intcurrent;
+  uint8_t dio_counter;
+} rpl_dag_t;
+
+typedef struct {
+  rpl_dag_t dag;
+  rpl_of_t *of;
+  uint16_t min_hoprankinc;
+  uint8_t instance_id;
+  uint8_t dio_intmin;
+  uint8_t dio_redundancy;
+} rpl_instance_t;
+
+extern rpl_instance_t curr_instance;
+#define ROOT_RANK (curr_instance.min_hoprankinc)
+
+rpl_nbr_t *rpl_neighbor_get_from_ipaddr(uip_ipaddr_t *addr);
+uip_ipaddr_t *rpl_neighbor_get_ipaddr(rpl_nbr_t *nbr);
+uint16_t rpl_neighbor_get_link_metric(rpl_nbr_t *nbr);
+
+/*---------------------------------------------------------------------------*/
+/* Energest: the simulator models no hardware, every counter reads zero */
+#define ENERGEST_TYPE_CPU 0
+#define ENERGEST_TYPE_LPM 1
+#define ENERGEST_TYPE_TRANSMIT 2
+#define ENERGEST_TYPE_LISTEN 3
+void energest_flush(void);
+uint64_t energest_type_time(int type);
+
+/*---------------------------------------------------------------------------*/
+/* Logging, in Cooja's line format with a runtime level */
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DBG 4
+
+void shim_log(int level, const char *module, int prefix, const char *fmt, ...)
+  __attribute__((format(printf, 4, 5)));
+void shim_log_6addr(int level, const uip_ipaddr_t *addr);
+
+#define LOG_ERR(...) shim_log(LOG_LEVEL_ERR, LOG_MODULE, 1, __VA_ARGS__)
+#define LOG_WARN(...) shim_log(LOG_LEVEL_WARN, LOG_MODULE, 1, __VA_ARGS__)
+#define LOG_INFO(...) shim_log(LOG_LEVEL_INFO, LOG_MODULE, 1, __VA_ARGS__)
+#define LOG_DBG(...) shim_log(LOG_LEVEL_DBG, LOG_MODULE, 1, __VA_ARGS__)
+#define LOG_ERR_(...) shim_log(LOG_LEVEL_ERR, LOG_MODULE, 0, __VA_ARGS__)
+#define LOG_WARN_(...) shim_log(LOG_LEVEL_WARN, LOG_MODULE, 0, __VA_ARGS__)
+#define LOG_INFO_(...) shim_log(LOG_LEVEL_INFO, LOG_MODULE, 0, __VA_ARGS__)
+#define LOG_DBG_(...) shim_log(LOG_LEVEL_DBG, LOG_MODULE, 0, __VA_ARGS__)
+#define LOG_ERR_6ADDR(a) shim_log_6addr(LOG_LEVEL_ERR, a)
+#define LOG_WARN_6ADDR(a) shim_log_6addr(LOG_LEVEL_WARN, a)
+#define LOG_INFO_6ADDR(a) shim_log_6addr(LOG_LEVEL_INFO, a)
+#define LOG_DBG_6ADDR(a) shim_log_6addr(LOG_LEVEL_DBG, a)
+
+#endif /* SHIM_H_ */
@@ -1,15 +1,31 @@
 #include "contiki.h"
 #include "net/routing/routing.h"
+#include "net/routing/rpl-lite/rpl.h"
 #include "net/netstack.h"
+#include "net/ipv6/uip.h"
 #include "net/ipv6/simple-udp.h"
 #include "sys/log.h"
+#include "sys/energest.h"
 
 #define LOG_MODULE "DIO-Baseline"
 #define LOG_LEVEL LOG_LEVEL_INFO
 
-/* Statistics for baseline comparison */
+PROCESS_NAME(dio_baseline_process);
+
+/* Statistics for baseline comparison (same fields as the mitigation's [AB]) */
 static uint32_t dio_received = 0;
 static uint32_t dio_processed = 0;
+static uint32_t tap_ticks = 0;
+
+/* RPL side effects observed right after a DIO was handed to RPL */
+static uint32_t trickle_resets = 0;
+static uint32_t parent_changes = 0;
+static uint8_t pre_dio_intcurrent = 0;
+static rpl_nbr_t *pre_dio_parent = NULL;
+
+/* Energest and time at the previous [AB] report */
+static uint64_t last_cpu, last_lpm, last_tx, last_rx;
+static uint32_t last_report_time = 0;
 
 /*---------------------------------------------------------------------------*/
 /* Process incoming DIO without any protection */
@@ -19,15 +35,100 @@ process_dio_baseline(const uip_ipaddr_t *sender,
 {
   dio_received++;
   
-  LOG_INFO("DIO received from ");
-  LOG_INFO_6ADDR(sender);
-  LOG_INFO_(" (length: %u bytes)\n", dio_len);
+  /* Debug only: a log line per DIO would dwarf the cost being compared */
+  LOG_DBG("DIO received from ");
+  LOG_DBG_6ADDR(sender);
+  LOG_DBG_(" (length: %u bytes)\n", dio_len);
 
   /* No replay detection - accept all DIOs */
   dio_processed++;
-  
-  /* Process the DIO message (would call RPL processing here) */
-  /* In real implementation, forward to rpl_dio_input() */
+}
+
+/*---------------------------------------------------------------------------*/
+/* IP packet processor: same hook point as the mitigation node, pass-through */
+static enum netstack_ip_action
+dio_tap_input(void)
+{
+  struct uip_icmp_hdr *icmp = (struct uip_icmp_hdr *)&uip_buf[UIP_IPH_LEN];
+  rtimer_clock_t start = RTIMER_NOW();
+
+  if(uip_len < UIP_IPH_LEN + UIP_ICMPH_LEN ||
+     UIP_IP_BUF->proto != UIP_PROTO_ICMP6 ||
+     icmp->type != ICMP6_RPL || icmp->icode != RPL_CODE_DIO) {
+    return NETSTACK_IP_PROCESS;
+  }
+
+  process_dio_baseline(&UIP_IP_BUF->srcipaddr,
+                       &uip_buf[UIP_IPH_LEN + UIP_ICMPH_LEN],
+                       uip_len - UIP_IPH_LEN - UIP_ICMPH_LEN);
+
+  /* RPL runs synchronously after us; compare its state once it is done */
+  pre_dio_intcurrent = curr_instance.dag.dio_intcurrent;
+  pre_dio_parent = curr_instance.dag.preferred_parent;
+  process_poll(&dio_baseline_process);
+
+  tap_ticks += RTIMER_NOW() - start;
+  return NETSTACK_IP_PROCESS;
+}
+
+static struct netstack_ip_packet_processor dio_tap_processor = {
+  .process_input = dio_tap_input,
+  .process_output = NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* Count Trickle resets and parent changes caused by the last DIO */
+static void
+check_rpl_side_effects(void)
+{
+  if(curr_instance.dag.state < DAG_INITIALIZED) {
+    return;
+  }
+  /* Trickle only shrinks its interval on a reset */
+  if(curr_instance.dag.dio_intcurrent < pre_dio_intcurrent) {
+    trickle_resets++;
+  }
+  if(pre_dio_parent != NULL &&
+     curr_instance.dag.preferred_parent != pre_dio_parent) {
+    parent_changes++;
+  }
+  pre_dio_intcurrent = curr_instance.dag.dio_intcurrent;
+  pre_dio_parent = curr_instance.dag.preferred_parent;
+}
+
+/*---------------------------------------------------------------------------*/
+/* One line with the counters the mitigation node prints under the same tag:
+ * role,secs,dio_rx,dio_passed,dio_dropped,tap_us,resets,parent_sw,cpu,lpm,tx,rx
+ * Energest values are ticks since the previous [AB] line. */
+static void
+print_ab_line(void)
+{
+  uint64_t cpu, lpm, tx, rx;
+  uint32_t now = (uint32_t)clock_seconds();
+
+  energest_flush();
+  cpu = energest_type_time(ENERGEST_TYPE_CPU);
+  lpm = energest_type_time(ENERGEST_TYPE_LPM);
+  tx = energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  rx = energest_type_time(ENERGEST_TYPE_LISTEN);
+
+  LOG_INFO("[AB] baseline,%lu,%lu,%lu,0,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+           (unsigned long)(now - last_report_time),
+           (unsigned long)dio_received,
+           (unsigned long)dio_processed,
+           (unsigned long)((uint64_t)tap_ticks * 1000000 / RTIMER_SECOND),
+           (unsigned long)trickle_resets,
+           (unsigned long)parent_changes,
+           (unsigned long)(cpu - last_cpu),
+           (unsigned long)(lpm - last_lpm),
+           (unsigned long)(tx - last_tx),
+           (unsigned long)(rx - last_rx));
+
+  last_cpu = cpu;
+  last_lpm = lpm;
+  last_tx = tx;
+  last_rx = rx;
+  last_report_time = now;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -38,8 +139,14 @@ print_baseline_statistics(void)
   LOG_INFO("=== Baseline (Unprotected) Statistics ===\n");
   LOG_INFO("Total DIOs received: %lu\n", (unsigned long)dio_received);
   LOG_INFO("DIOs processed: %lu\n", (unsigned long)dio_processed);
+  LOG_INFO("Tap time: %lu us/DIO\n", dio_received > 0 ?
+           (unsigned long)((uint64_t)tap_ticks * 1000000 /
+                           RTIMER_SECOND / dio_received) : 0);
+  LOG_INFO("Trickle resets: %lu\n", (unsigned long)trickle_resets);
+  LOG_INFO("Parent changes: %lu\n", (unsigned long)parent_changes);
   LOG_INFO("Protection: NONE (baseline)\n");
   LOG_INFO("=========================================\n");
+  print_ab_line();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -55,12 +162,19 @@ PROCESS_THREAD(dio_baseline_process, ev, data)
   LOG_INFO("DIO Baseline (Unprotected) initialized\n");
   LOG_WARN("WARNING: No replay attack protection active!\n");
 
+  netstack_ip_packet_processor_add(&dio_tap_processor);
+  last_report_time = (uint32_t)clock_seconds();
+
   /* Set up statistics timer */
   etimer_set(&stat_timer, CLOCK_SECOND * 60);
 
   while(1) {
     PROCESS_WAIT_EVENT();
 
+    if(ev == PROCESS_EVENT_POLL) {
+      check_rpl_side_effects();
+    }
+
     if(etimer_expired(&stat_timer)) {
       print_baseline_statistics();
       etimer_reset(&stat_timer);
@@ -4,13 +4,91 @@
 #include "net/routing/rpl-lite/rpl-dag.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/uip-ds6-nbr.h"
+#include "net/ipv6/uip-icmp6.h"
+#include "net/ipv6/uipbuf.h"
+#include "net/netstack.h"
 #include "net/packetbuf.h"
 #include "sys/log.h"
 #include "sys/energest.h"
+#include "net/ipv6/uiplib.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* End-to-end probes to the root's udp-server (rpl-udp example) */
+#ifndef EVAL_CONF_WITH_PROBES
+#define EVAL_CONF_WITH_PROBES 0
+#endif
+
+#if EVAL_CONF_WITH_PROBES
+#include "net/ipv6/simple-udp.h"
+#include "node-id.h"
+#include "random.h"
+#endif
+
+/* Per-second metric history in RAM, dumped on the serial command
+ * "history" */
+#ifndef EVAL_CONF_WITH_HISTORY
+#define EVAL_CONF_WITH_HISTORY 0
+#endif
+
+#if EVAL_CONF_WITH_HISTORY
+#include "dev/serial-line.h"
+#endif
 
 #define LOG_MODULE "DIO-Evaluator"
 #define LOG_LEVEL LOG_LEVEL_INFO
 
+/* Reporting schedule: one timer ticks every EVAL_TICK seconds and every
+ * report period is a whole number of ticks */
+#define EVAL_TICK 30      /* Quick update */
+#define REPORT_TICKS 4    /* Detailed report every 2 minutes */
+#define NEIGHBOR_TICKS 10 /* Neighbor details every 5 minutes */
+
+/* Report lines are collected here and written out once per tick, or
+ * earlier when the buffer fills */
+#ifndef EVAL_OUT_SIZE
+#define EVAL_OUT_SIZE 1024
+#endif
+
+/* RPL control messages, indexed by ICMPv6 code (DIS, DIO, DAO, DAO-ACK) */
+#define RPL_MSG_TYPES 4
+
+/* DIO inter-arrival histogram per neighbor: bucket 0 holds gaps below
+ * 2^DIO_GAP_MIN_LOG2 ms, each further bucket one doubling, the last one
+ * is open-ended */
+#define DIO_GAP_BUCKETS 16
+#define DIO_GAP_MIN_LOG2 7
+
+#if EVAL_CONF_WITH_PROBES
+#define PROBE_CLIENT_PORT 8765 /* Ports udp-server.c serves and echoes on */
+#define PROBE_SERVER_PORT 5678
+#ifndef PROBE_INTERVAL
+#define PROBE_INTERVAL 10      /* Seconds between probes, +- 1/4 jitter */
+#endif
+#define PROBE_WINDOW 16        /* Probes awaiting their echo */
+#define PROBE_SAMPLES 32       /* RTT samples kept per report */
+#define PROBE_PAYLOAD 32
+#endif
+
+#if EVAL_CONF_WITH_HISTORY
+/* Samples are delta-of-delta coded into blocks; the oldest block is
+ * overwritten when the ring is full */
+#ifndef EVAL_HISTORY_SIZE
+#define EVAL_HISTORY_SIZE 512  /* Bytes of encoded samples */
+#endif
+#ifndef EVAL_HISTORY_PERIOD
+#define EVAL_HISTORY_PERIOD 1  /* Seconds between samples */
+#endif
+#define HISTORY_BLOCK 128      /* Bytes per block */
+#define HISTORY_BLOCKS (EVAL_HISTORY_SIZE / HISTORY_BLOCK)
+/* Rank, neighbors, Energest CPU/LPM/TX/RX, DIOs and DIS received */
+#define HISTORY_CHANNELS 8
+/* Channel mask, then one zigzag varint per changed channel */
+#define HISTORY_MAX_SAMPLE (1 + HISTORY_CHANNELS * 5)
+#endif
+
 /* Enhanced evaluation metrics */
 typedef struct {
   /* RPL Metrics */
@@ -59,6 +137,10 @@ typedef struct {
   uint32_t first_seen;
   uint32_t last_seen;
   uint32_t dio_count;
+  uint16_t dis_count;
+  uint16_t dao_count;
+  clock_time_t last_dio;
+  uint16_t dio_gaps[DIO_GAP_BUCKETS];
   uint8_t is_parent;
   uint8_t was_parent;
 } neighbor_info_t;
@@ -66,6 +148,93 @@ typedef struct {
 #define MAX_TRACKED_NEIGHBORS 10
 static neighbor_info_t tracked_neighbors[MAX_TRACKED_NEIGHBORS];
 
+/* Per RPL instance and DODAG: what we heard of it and how we fared in it.
+ * Rank, version and parent changes only compare within one DODAG. */
+typedef struct {
+  uip_ipaddr_t dodag_id;
+  uint8_t instance_id;
+  uint8_t version;       /* Newest version heard in a DIO */
+  uint16_t best_rank;    /* Lowest rank heard in a DIO */
+  uint32_t dio_rx;
+  uint32_t last_heard;
+  uint32_t joined_time;  /* Seconds spent in it */
+  uint32_t rank_changes;
+  uint32_t parent_switches;
+} dodag_metrics_t;
+
+#define EVAL_MAX_DODAGS 4
+static dodag_metrics_t tracked_dodags[EVAL_MAX_DODAGS];
+static dodag_metrics_t *joined_dodag = NULL; /* Last DODAG we were in */
+
+/* RPL control traffic seen by the IP packet hooks */
+typedef struct {
+  uint32_t rx;
+  uint32_t tx;
+  uint32_t rx_bytes;
+  uint32_t tx_bytes;
+} rpl_msg_count_t;
+
+static rpl_msg_count_t rpl_msgs[RPL_MSG_TYPES];
+static const char *const rpl_msg_names[RPL_MSG_TYPES] = {
+  "DIS", "DIO", "DAO", "DAO-ACK"
+};
+
+#if EVAL_CONF_WITH_PROBES
+/* Probe counters; one set for the run, one for the current report */
+typedef struct {
+  uint32_t sent;
+  uint32_t skipped;      /* No route to the root when due */
+  uint32_t echoed;
+  uint32_t lost;         /* Slot reused before the echo came back */
+  uint32_t late;         /* Echo for a probe already counted lost */
+  uint32_t out_of_order;
+  uint32_t duplicates;
+} probe_count_t;
+
+typedef struct {
+  uint32_t seq;
+  clock_time_t tx;
+  uint8_t pending;
+} probe_slot_t;
+
+static struct simple_udp_connection probe_conn;
+static struct etimer probe_timer;
+static probe_slot_t probe_window[PROBE_WINDOW];
+static probe_count_t probe_total;
+static probe_count_t probe_period;
+static uint32_t probe_next_seq = 0;
+static uint32_t probe_highest_echo = 0;
+static uint16_t probe_rtt[PROBE_SAMPLES]; /* ms, this report */
+static uint8_t probe_rtt_count = 0;
+
+#define PROBE_COUNT(field) do { \
+    probe_total.field++;        \
+    probe_period.field++;       \
+  } while(0)
+#endif
+
+#if EVAL_CONF_WITH_HISTORY
+/* One block of samples. Each sample is a channel mask byte followed by
+ * the delta-of-delta of every channel set in it; a 0 mask is followed by
+ * a count of samples in which nothing changed. The first sample of a
+ * block is coded against zero, so every block decodes on its own. */
+typedef struct {
+  uint32_t start;   /* clock_seconds() of the first sample */
+  uint16_t samples;
+  uint16_t len;
+  uint8_t data[HISTORY_BLOCK];
+} history_block_t;
+
+static history_block_t history[HISTORY_BLOCKS];
+static uint8_t history_head = 0;        /* Block being written */
+static uint16_t history_run = 0;        /* Offset of an open run count, or 0 */
+static uint32_t history_prev[HISTORY_CHANNELS];
+static int32_t history_delta[HISTORY_CHANNELS];
+static uint32_t history_samples = 0;
+static uint32_t history_bytes = 0;      /* Encoded, including overwritten */
+static struct etimer history_timer;
+#endif
+
 /* Track previous values */
 static uint16_t last_rank = 0xFFFF;
 static uip_ipaddr_t last_parent;
@@ -87,6 +256,92 @@ static performance_stat_t rank_stability;
 static performance_stat_t neighbor_stability;
 static performance_stat_t energy_per_second;
 
+/* Scheduler accounting */
+static uint32_t tick_count = 0;
+static uint32_t last_update_time = 0;
+static rtimer_clock_t tick_cpu_ticks = 0;
+
+/* Batched output, in the same line format as the LOG_ macros */
+static char eval_out_buf[EVAL_OUT_SIZE];
+static uint16_t eval_out_len = 0;
+static uint32_t eval_out_writes = 0;
+
+#define EVAL_INFO(...) eval_log(1, "INFO", __VA_ARGS__)
+#define EVAL_INFO_(...) eval_log(0, "INFO", __VA_ARGS__)
+#define EVAL_WARN(...) eval_log(1, "WARN", __VA_ARGS__)
+#define EVAL_INFO_6ADDR(addr) eval_log_6addr(addr)
+
+/*---------------------------------------------------------------------------*/
+/* Write out everything collected so far in one go */
+static void
+eval_flush(void)
+{
+  if(eval_out_len > 0) {
+    printf("%s", eval_out_buf);
+    eval_out_len = 0;
+    eval_out_buf[0] = '\0';
+    eval_out_writes++;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+eval_append(const char *fmt, va_list ap)
+{
+  va_list retry;
+  int n;
+
+  va_copy(retry, ap);
+  n = vsnprintf(eval_out_buf + eval_out_len, EVAL_OUT_SIZE - eval_out_len,
+                fmt, ap);
+  if(n >= EVAL_OUT_SIZE - eval_out_len && eval_out_len > 0) {
+    /* Does not fit behind what is queued: write that out first */
+    eval_out_buf[eval_out_len] = '\0';
+    eval_flush();
+    n = vsnprintf(eval_out_buf, EVAL_OUT_SIZE, fmt, retry);
+  }
+  va_end(retry);
+  if(n > 0) {
+    eval_out_len += n < EVAL_OUT_SIZE - eval_out_len ?
+                    n : EVAL_OUT_SIZE - 1 - eval_out_len;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+eval_printf(const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  eval_append(fmt, ap);
+  va_end(ap);
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+eval_log(int prefix, const char *level, const char *fmt, ...)
+{
+  va_list ap;
+
+  if(prefix) {
+    eval_printf("[%-4s: %-10s] ", level, LOG_MODULE);
+  }
+  va_start(ap, fmt);
+  eval_append(fmt, ap);
+  va_end(ap);
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+eval_log_6addr(const uip_ipaddr_t *addr)
+{
+  char buf[UIPLIB_IPV6_MAX_STR_LEN];
+
+  uiplib_ipaddr_snprint(buf, sizeof(buf), addr);
+  eval_printf("%s", buf);
+}
+
 /*---------------------------------------------------------------------------*/
 static void
 init_metrics(void)
@@ -95,6 +350,9 @@ init_metrics(void)
   memset(&prev_metrics, 0, sizeof(evaluation_metrics_t));
   memset(&last_parent, 0, sizeof(uip_ipaddr_t));
   memset(&tracked_neighbors, 0, sizeof(tracked_neighbors));
+  memset(&tracked_dodags, 0, sizeof(tracked_dodags));
+  joined_dodag = NULL;
+  memset(rpl_msgs, 0, sizeof(rpl_msgs));
   memset(&rank_stability, 0, sizeof(performance_stat_t));
   memset(&neighbor_stability, 0, sizeof(performance_stat_t));
   memset(&energy_per_second, 0, sizeof(performance_stat_t));
@@ -109,9 +367,9 @@ init_metrics(void)
   neighbor_stability.min_value = 0xFFFFFFFF;
   energy_per_second.min_value = 0xFFFFFFFF;
   
-  LOG_INFO("╔════════════════════════════════════════════╗\n");
-  LOG_INFO("║    Enhanced Evaluation System Started      ║\n");
-  LOG_INFO("╚════════════════════════════════════════════╝\n");
+  EVAL_INFO("╔════════════════════════════════════════════╗\n");
+  EVAL_INFO("║    Enhanced Evaluation System Started      ║\n");
+  EVAL_INFO("╚════════════════════════════════════════════╝\n");
 }
 
 /*---------------------------------------------------------------------------*/
@@ -153,6 +411,37 @@ find_or_create_neighbor(const uip_ipaddr_t *addr)
   return oldest;
 }
 
+/*---------------------------------------------------------------------------*/
+static dodag_metrics_t *
+find_or_create_dodag(uint8_t instance_id, const uip_ipaddr_t *dodag_id)
+{
+  int i;
+  dodag_metrics_t *oldest = NULL;
+  uint32_t oldest_time = 0xFFFFFFFF;
+  
+  /* Find existing */
+  for(i = 0; i < EVAL_MAX_DODAGS; i++) {
+    if(tracked_dodags[i].last_heard > 0 &&
+       tracked_dodags[i].instance_id == instance_id &&
+       uip_ipaddr_cmp(&tracked_dodags[i].dodag_id, dodag_id)) {
+      return &tracked_dodags[i];
+    }
+    /* The DODAG we are in keeps its slot */
+    if(&tracked_dodags[i] != joined_dodag &&
+       tracked_dodags[i].last_heard < oldest_time) {
+      oldest_time = tracked_dodags[i].last_heard;
+      oldest = &tracked_dodags[i];
+    }
+  }
+  
+  /* Create new */
+  memset(oldest, 0, sizeof(dodag_metrics_t));
+  oldest->instance_id = instance_id;
+  uip_ipaddr_copy(&oldest->dodag_id, dodag_id);
+  oldest->best_rank = 0xFFFF;
+  return oldest;
+}
+
 /*---------------------------------------------------------------------------*/
 static void
 update_energy_metrics(void)
@@ -186,24 +475,43 @@ update_rpl_metrics(void)
   rpl_nbr_t *nbr;
   int neighbor_count = 0;
   uint32_t current_time = (uint32_t)clock_seconds();
+  uint32_t elapsed;
+  dodag_metrics_t *dodag;
   
   /* Update total uptime */
   metrics.total_uptime = current_time - metrics.start_time;
+  elapsed = current_time - last_update_time;
+  last_update_time = current_time;
   
   /* Check if we're part of a DODAG */
   uint8_t in_dodag = (curr_instance.dag.state >= DAG_INITIALIZED);
   
   if(in_dodag) {
-    metrics.connected_time++;
+    metrics.connected_time += elapsed;
     
     /* Track DODAG join */
     if(!was_in_dodag) {
       metrics.dodag_joins++;
       last_join_time = current_time;
-      LOG_INFO("✓ JOINED DODAG (join #%lu)\n", 
+      EVAL_INFO("✓ JOINED DODAG (join #%lu)\n", 
                (unsigned long)metrics.dodag_joins);
     }
     
+    /* Changes are only compared within one DODAG */
+    dodag = find_or_create_dodag(curr_instance.instance_id,
+                                 &curr_instance.dag.dag_id);
+    dodag->last_heard = current_time;
+    dodag->joined_time += elapsed;
+    if(joined_dodag != NULL && joined_dodag != dodag) {
+      EVAL_INFO("⇄ DODAG switch to instance %u ", dodag->instance_id);
+      EVAL_INFO_6ADDR(&dodag->dodag_id);
+      EVAL_INFO_("\n");
+      last_rank = 0xFFFF;
+      last_version = 0;
+      first_parent = 1;
+    }
+    joined_dodag = dodag;
+    
     /* Get current rank */
     metrics.current_rank = curr_instance.dag.rank;
     metrics.dodag_version = curr_instance.dag.version;
@@ -220,8 +528,9 @@ update_rpl_metrics(void)
     /* Detect rank changes */
     if(last_rank != 0xFFFF && last_rank != metrics.current_rank) {
       metrics.rank_changes++;
+      dodag->rank_changes++;
       int32_t rank_delta = (int32_t)metrics.current_rank - (int32_t)last_rank;
-      LOG_INFO("Rank change: %u -> %u (%s%ld)\n", 
+      EVAL_INFO("Rank change: %u -> %u (%s%ld)\n", 
                last_rank, metrics.current_rank,
                rank_delta > 0 ? "+" : "", (long)rank_delta);
     }
@@ -229,7 +538,7 @@ update_rpl_metrics(void)
     
     /* Detect version changes */
     if(last_version != 0 && last_version != metrics.dodag_version) {
-      LOG_INFO("⚡ DODAG version change: %u -> %u\n", 
+      EVAL_INFO("⚡ DODAG version change: %u -> %u\n", 
                last_version, metrics.dodag_version);
     }
     last_version = metrics.dodag_version;
@@ -249,7 +558,6 @@ update_rpl_metrics(void)
         neighbor_info_t *info = find_or_create_neighbor(addr);
         info->rank = nbr->rank;
         info->last_seen = current_time;
-        info->dio_count++;
       }
       
       nbr = nbr_table_next(rpl_neighbors, nbr);
@@ -266,9 +574,10 @@ update_rpl_metrics(void)
       
       if(!first_parent && !uip_ipaddr_cmp(&last_parent, parent)) {
         metrics.parent_switches++;
-        LOG_INFO("🔄 Parent switch to ");
-        LOG_INFO_6ADDR(parent);
-        LOG_INFO_(" (switch #%lu)\n", 
+        dodag->parent_switches++;
+        EVAL_INFO("🔄 Parent switch to ");
+        EVAL_INFO_6ADDR(parent);
+        EVAL_INFO_(" (switch #%lu)\n", 
                  (unsigned long)metrics.parent_switches);
         
         /* Mark old parent */
@@ -283,7 +592,7 @@ update_rpl_metrics(void)
     }
     
   } else {
-    metrics.disconnected_time++;
+    metrics.disconnected_time += elapsed;
     metrics.current_rank = 0xFFFF;
     metrics.rpl_neighbors = 0;
     
@@ -292,7 +601,7 @@ update_rpl_metrics(void)
       metrics.dodag_leaves++;
       last_leave_time = current_time;
       uint32_t connected_duration = last_leave_time - last_join_time;
-      LOG_WARN("✗ LEFT DODAG (leave #%lu, was connected %lus)\n", 
+      EVAL_WARN("✗ LEFT DODAG (leave #%lu, was connected %lus)\n", 
                (unsigned long)metrics.dodag_leaves,
                (unsigned long)connected_duration);
     }
@@ -301,6 +610,458 @@ update_rpl_metrics(void)
   was_in_dodag = in_dodag;
 }
 
+/*---------------------------------------------------------------------------*/
+/* RPL message code of the packet in uip_buf, or -1 for anything else.
+ * Extension headers are skipped: DAOs carry the RPL hop-by-hop option.
+ * body is set to the message past the ICMPv6 header. */
+static int
+rpl_message_code(const uint8_t **body)
+{
+  uint8_t proto;
+  struct uip_icmp_hdr *icmp = (struct uip_icmp_hdr *)
+    uipbuf_get_last_header(uip_buf, uip_len, &proto);
+
+  if(icmp == NULL || proto != UIP_PROTO_ICMP6 ||
+     (uint8_t *)icmp + UIP_ICMPH_LEN > uip_buf + uip_len ||
+     icmp->type != ICMP6_RPL || icmp->icode >= RPL_MSG_TYPES) {
+    return -1;
+  }
+  *body = (uint8_t *)icmp + UIP_ICMPH_LEN;
+  return icmp->icode;
+}
+
+/*---------------------------------------------------------------------------*/
+/* File a DIO gap under its log2 bucket */
+static void
+record_dio_gap(neighbor_info_t *info, clock_time_t now)
+{
+  uint32_t gap = (uint32_t)((now - info->last_dio) * 1000 / CLOCK_SECOND) >>
+                 DIO_GAP_MIN_LOG2;
+  uint8_t bucket = 0;
+
+  while(gap > 0 && bucket < DIO_GAP_BUCKETS - 1) {
+    gap >>= 1;
+    bucket++;
+  }
+  if(info->dio_gaps[bucket] < 0xFFFF) {
+    info->dio_gaps[bucket]++;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Account a received DIO to its instance and DODAG */
+static void
+record_dio_dodag(const uint8_t *body)
+{
+  uip_ipaddr_t dodag_id;
+  dodag_metrics_t *dodag;
+  uint16_t rank;
+
+  /* Instance, version, rank, flags, DTSN, reserved, DODAG ID */
+  if(body + 8 + sizeof(uip_ipaddr_t) > uip_buf + uip_len) {
+    return;
+  }
+  memcpy(&dodag_id, &body[8], sizeof(dodag_id));
+  dodag = find_or_create_dodag(body[0], &dodag_id);
+  if(dodag->dio_rx == 0 ||
+     RPL_LOLLIPOP_GREATER_THAN(body[1], dodag->version)) {
+    dodag->version = body[1];
+  }
+  rank = (body[2] << 8) | body[3];
+  if(rank < dodag->best_rank) {
+    dodag->best_rank = rank;
+  }
+  dodag->dio_rx++;
+  dodag->last_heard = (uint32_t)clock_seconds();
+}
+
+/*---------------------------------------------------------------------------*/
+/* IP packet processor: counts every received packet and RPL message */
+static enum netstack_ip_action
+rpl_tap_input(void)
+{
+  neighbor_info_t *info;
+  clock_time_t now = clock_time();
+  const uint8_t *body;
+  int code = rpl_message_code(&body);
+
+  metrics.packets_received++;
+  if(code < 0) {
+    return NETSTACK_IP_PROCESS;
+  }
+  rpl_msgs[code].rx++;
+  rpl_msgs[code].rx_bytes += uip_len;
+  if(code == RPL_CODE_DAO_ACK) {
+    metrics.dao_ack_received++;
+    return NETSTACK_IP_PROCESS;
+  }
+
+  if(code == RPL_CODE_DIO) {
+    metrics.dio_received++;
+    record_dio_dodag(body);
+  }
+
+  /* Non-storing DAOs arrive from origins many hops away; only one-hop
+   * senders get a slot in the neighbor table */
+  if(!uip_is_addr_linklocal(&UIP_IP_BUF->srcipaddr) &&
+     rpl_neighbor_get_from_ipaddr(&UIP_IP_BUF->srcipaddr) == NULL) {
+    return NETSTACK_IP_PROCESS;
+  }
+  info = find_or_create_neighbor(&UIP_IP_BUF->srcipaddr);
+  info->last_seen = (uint32_t)clock_seconds();
+  if(code == RPL_CODE_DIO) {
+    if(info->dio_count > 0) {
+      record_dio_gap(info, now);
+    }
+    info->dio_count++;
+    info->last_dio = now;
+  } else if(code == RPL_CODE_DIS) {
+    info->dis_count++;
+  } else {
+    info->dao_count++;
+  }
+  return NETSTACK_IP_PROCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/* IP packet processor: counts every sent packet and RPL message */
+static enum netstack_ip_action
+rpl_tap_output(const linkaddr_t *localdest)
+{
+  const uint8_t *body;
+  int code = rpl_message_code(&body);
+
+  metrics.packets_sent++;
+  if(code < 0) {
+    return NETSTACK_IP_PROCESS;
+  }
+  rpl_msgs[code].tx++;
+  rpl_msgs[code].tx_bytes += uip_len;
+  if(code == RPL_CODE_DIS) {
+    metrics.dis_sent++;
+  } else if(code == RPL_CODE_DAO) {
+    metrics.dao_sent++;
+  }
+  return NETSTACK_IP_PROCESS;
+}
+
+static struct netstack_ip_packet_processor rpl_tap_processor = {
+  .process_input = rpl_tap_input,
+  .process_output = rpl_tap_output
+};
+
+#if EVAL_CONF_WITH_PROBES
+/*---------------------------------------------------------------------------*/
+/* Send the next sequenced, timestamped probe to the root. The payload is
+ * text so the server's "Received request" log line carries it too. */
+static void
+probe_send(void)
+{
+  uip_ipaddr_t root;
+  probe_slot_t *slot;
+  char payload[PROBE_PAYLOAD];
+  clock_time_t now = clock_time();
+  int len;
+
+  if(!NETSTACK_ROUTING.node_is_reachable() ||
+     !NETSTACK_ROUTING.get_root_ipaddr(&root)) {
+    PROBE_COUNT(skipped);
+    return;
+  }
+
+  slot = &probe_window[probe_next_seq % PROBE_WINDOW];
+  if(slot->pending) {
+    PROBE_COUNT(lost);
+  }
+  slot->seq = probe_next_seq;
+  slot->tx = now;
+  slot->pending = 1;
+
+  len = snprintf(payload, sizeof(payload), "probe %u %lu %lu", node_id,
+                 (unsigned long)probe_next_seq,
+                 (unsigned long)((uint64_t)now * 1000 / CLOCK_SECOND));
+  simple_udp_sendto(&probe_conn, payload, len, &root);
+  probe_next_seq++;
+  PROBE_COUNT(sent);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Echo from udp-server.c: match it to its slot and take the RTT */
+static void
+probe_rx_callback(struct simple_udp_connection *c,
+                  const uip_ipaddr_t *sender_addr, uint16_t sender_port,
+                  const uip_ipaddr_t *receiver_addr, uint16_t receiver_port,
+                  const uint8_t *data, uint16_t datalen)
+{
+  char payload[PROBE_PAYLOAD];
+  char *p;
+  unsigned long id;
+  uint32_t seq;
+  uint32_t rtt;
+  probe_slot_t *slot;
+
+  if(datalen >= sizeof(payload)) {
+    return;
+  }
+  memcpy(payload, data, datalen);
+  payload[datalen] = '\0';
+  if(strncmp(payload, "probe ", 6) != 0) {
+    return;
+  }
+  id = strtoul(payload + 6, &p, 10);
+  seq = strtoul(p, NULL, 10);
+  if(id != node_id || seq >= probe_next_seq) {
+    return;
+  }
+
+  slot = &probe_window[seq % PROBE_WINDOW];
+  if(slot->seq != seq) {
+    PROBE_COUNT(late);
+    return;
+  }
+  if(!slot->pending) {
+    PROBE_COUNT(duplicates);
+    return;
+  }
+  slot->pending = 0;
+  PROBE_COUNT(echoed);
+  if(probe_total.echoed > 1 && seq < probe_highest_echo) {
+    PROBE_COUNT(out_of_order);
+  } else {
+    probe_highest_echo = seq;
+  }
+
+  rtt = (uint32_t)((uint64_t)(clock_time() - slot->tx) * 1000 / CLOCK_SECOND);
+  if(probe_rtt_count < PROBE_SAMPLES) {
+    probe_rtt[probe_rtt_count++] = rtt < 0xFFFF ? rtt : 0xFFFF;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+probe_init(void)
+{
+  memset(probe_window, 0, sizeof(probe_window));
+  memset(&probe_total, 0, sizeof(probe_total));
+  memset(&probe_period, 0, sizeof(probe_period));
+  simple_udp_register(&probe_conn, PROBE_CLIENT_PORT, NULL,
+                      PROBE_SERVER_PORT, probe_rx_callback);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Probe timer with +- 1/4 jitter, so motes do not probe in lockstep */
+static void
+probe_schedule(void)
+{
+  clock_time_t interval = PROBE_INTERVAL * CLOCK_SECOND;
+
+  etimer_set(&probe_timer, interval - interval / 4 +
+             random_rand() % (interval / 2 + 1));
+}
+
+/*---------------------------------------------------------------------------*/
+/* Percentile of this report's RTT samples, which are sorted in place */
+static uint16_t
+probe_percentile(uint8_t pct)
+{
+  uint8_t i, j;
+  uint16_t v;
+
+  if(probe_rtt_count == 0) {
+    return 0;
+  }
+  for(i = 1; i < probe_rtt_count; i++) {
+    v = probe_rtt[i];
+    for(j = i; j > 0 && probe_rtt[j - 1] > v; j--) {
+      probe_rtt[j] = probe_rtt[j - 1];
+    }
+    probe_rtt[j] = v;
+  }
+  return probe_rtt[(uint16_t)(probe_rtt_count - 1) * pct / 100];
+}
+
+/*---------------------------------------------------------------------------*/
+/* Data-plane box and [PRB] line; starts the next report period */
+static void
+print_probe_report(void)
+{
+  uint32_t attempts = probe_period.sent + probe_period.skipped;
+  uint16_t p50 = probe_percentile(50);
+  uint16_t p90 = probe_percentile(90);
+  uint16_t p99 = probe_percentile(99);
+
+  EVAL_INFO("\n┌─── DATA PLANE (probes to root) ──────────────────────────┐\n");
+  EVAL_INFO("│ Sent: %lu | No route: %lu | Echoed: %lu | Lost: %lu       │\n",
+           (unsigned long)probe_period.sent,
+           (unsigned long)probe_period.skipped,
+           (unsigned long)probe_period.echoed,
+           (unsigned long)probe_period.lost);
+  EVAL_INFO("│ Out of order: %lu | Duplicates: %lu | Late: %lu          │\n",
+           (unsigned long)probe_period.out_of_order,
+           (unsigned long)probe_period.duplicates,
+           (unsigned long)probe_period.late);
+  EVAL_INFO("│ PDR:          %.1f%% (run: %.1f%%)                        │\n",
+           attempts > 0 ? probe_period.echoed * 100.0 / attempts : 0,
+           probe_total.sent + probe_total.skipped > 0 ?
+           probe_total.echoed * 100.0 /
+           (probe_total.sent + probe_total.skipped) : 0);
+  EVAL_INFO("│ RTT (ms):     p50=%u p90=%u p99=%u (%u samples)          │\n",
+           p50, p90, p99, probe_rtt_count);
+  EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
+
+  /* Run totals, then this period; the clock lets a log parser line up
+   * the server's receive times for one-way latency */
+  EVAL_INFO("[PRB] %lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%u,%u,%u\n",
+           (unsigned long)((uint64_t)clock_time() * 1000 / CLOCK_SECOND),
+           (unsigned long)probe_total.sent,
+           (unsigned long)probe_total.skipped,
+           (unsigned long)probe_total.echoed,
+           (unsigned long)probe_total.lost,
+           (unsigned long)probe_total.out_of_order,
+           (unsigned long)probe_total.duplicates,
+           (unsigned long)probe_period.echoed,
+           p50, p90, p99);
+
+  memset(&probe_period, 0, sizeof(probe_period));
+  probe_rtt_count = 0;
+}
+#endif /* EVAL_CONF_WITH_PROBES */
+
+#if EVAL_CONF_WITH_HISTORY
+/*---------------------------------------------------------------------------*/
+/* Zigzag varint: small magnitudes of either sign take one byte */
+static uint8_t
+history_put_varint(uint8_t *out, int32_t value)
+{
+  uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+  uint8_t len = 0;
+
+  while(v >= 0x80) {
+    out[len++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  out[len++] = v;
+  return len;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Encode one sample against the block's running state, without updating
+ * it; returns the length, 0 for a sample in which nothing changed */
+static uint8_t
+history_encode(const uint32_t *x, uint8_t *out)
+{
+  uint8_t i;
+  uint8_t len = 1;
+  int32_t dod;
+
+  out[0] = 0;
+  for(i = 0; i < HISTORY_CHANNELS; i++) {
+    dod = (int32_t)(x[i] - history_prev[i]) - history_delta[i];
+    if(dod != 0) {
+      out[0] |= 1 << i;
+      len += history_put_varint(&out[len], dod);
+    }
+  }
+  return out[0] == 0 ? 0 : len;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Take and encode the current value of every channel */
+static void
+history_sample(void)
+{
+  history_block_t *block = &history[history_head];
+  uint32_t x[HISTORY_CHANNELS];
+  uint8_t buf[HISTORY_MAX_SAMPLE];
+  uint8_t len;
+  uint8_t need;
+  uint8_t i;
+  rpl_nbr_t *nbr;
+
+  x[0] = curr_instance.dag.state >= DAG_INITIALIZED ?
+         curr_instance.dag.rank : 0xFFFF;
+  x[1] = 0;
+  for(nbr = nbr_table_head(rpl_neighbors); nbr != NULL;
+      nbr = nbr_table_next(rpl_neighbors, nbr)) {
+    x[1]++;
+  }
+  energest_flush();
+  x[2] = (uint32_t)energest_type_time(ENERGEST_TYPE_CPU);
+  x[3] = (uint32_t)energest_type_time(ENERGEST_TYPE_LPM);
+  x[4] = (uint32_t)energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  x[5] = (uint32_t)energest_type_time(ENERGEST_TYPE_LISTEN);
+  x[6] = rpl_msgs[RPL_CODE_DIO].rx;
+  x[7] = rpl_msgs[RPL_CODE_DIS].rx;
+
+  len = history_encode(x, buf);
+  need = len;
+  if(len == 0 && (history_run == 0 || block->data[history_run] == 0xFF)) {
+    need = 2;
+  }
+  if(block->samples > 0 && block->len + need > HISTORY_BLOCK) {
+    /* Start the next block, overwriting the oldest */
+    history_head = (history_head + 1) % HISTORY_BLOCKS;
+    block = &history[history_head];
+    memset(block, 0, sizeof(*block));
+    memset(history_prev, 0, sizeof(history_prev));
+    memset(history_delta, 0, sizeof(history_delta));
+    history_run = 0;
+    len = history_encode(x, buf);
+  }
+  if(block->samples == 0) {
+    block->start = (uint32_t)clock_seconds();
+  }
+
+  if(len > 0) {
+    memcpy(&block->data[block->len], buf, len);
+    block->len += len;
+    history_run = 0;
+  } else if(history_run > 0 && block->data[history_run] < 0xFF) {
+    block->data[history_run]++;
+  } else {
+    block->data[block->len] = 0;
+    block->data[block->len + 1] = 1;
+    history_run = block->len + 1;
+    block->len += 2;
+    len = 2;
+  }
+  history_bytes += len;
+
+  /* The first sample is the block's key frame: no slope yet */
+  for(i = 0; i < HISTORY_CHANNELS; i++) {
+    history_delta[i] = block->samples == 0 ? 0 :
+                       (int32_t)(x[i] - history_prev[i]);
+    history_prev[i] = x[i];
+  }
+  block->samples++;
+  history_samples++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Write out every block, oldest first, for tools/evhist.py to decode */
+static void
+history_dump(void)
+{
+  uint8_t i;
+  uint16_t j;
+  const history_block_t *block;
+
+  for(i = 1; i <= HISTORY_BLOCKS; i++) {
+    block = &history[(history_head + i) % HISTORY_BLOCKS];
+    if(block->samples == 0) {
+      continue;
+    }
+    EVAL_INFO("[HST] %lu,%u,%u,", (unsigned long)block->start,
+             EVAL_HISTORY_PERIOD, block->samples);
+    for(j = 0; j < block->len; j++) {
+      EVAL_INFO_("%02x", block->data[j]);
+    }
+    EVAL_INFO_("\n");
+    eval_flush();
+  }
+}
+#endif /* EVAL_CONF_WITH_HISTORY */
+
 /*---------------------------------------------------------------------------*/
 static float
 calculate_stability_score(void)
@@ -340,122 +1101,167 @@ calculate_stability_score(void)
 static void
 print_detailed_report(void)
 {
-  update_energy_metrics();
-  update_rpl_metrics();
-  
   uint32_t total_energy = metrics.energy_cpu + metrics.energy_lpm + 
                           metrics.energy_tx + metrics.energy_rx;
+  uint32_t ctl_msgs = 0;
+  uint32_t ctl_rx_bytes = 0;
+  uint32_t ctl_tx_bytes = 0;
+  int i;
   
   float stability_score = calculate_stability_score();
   
-  LOG_INFO("\n");
-  LOG_INFO("╔════════════════════════════════════════════════════════════╗\n");
-  LOG_INFO("║           RPL NETWORK EVALUATION REPORT                    ║\n");
-  LOG_INFO("╠════════════════════════════════════════════════════════════╣\n");
-  LOG_INFO("║ Time: %lu s | Uptime: %lu s | Score: %.1f/100         ║\n",
+  EVAL_INFO("\n");
+  EVAL_INFO("╔════════════════════════════════════════════════════════════╗\n");
+  EVAL_INFO("║           RPL NETWORK EVALUATION REPORT                    ║\n");
+  EVAL_INFO("╠════════════════════════════════════════════════════════════╣\n");
+  EVAL_INFO("║ Time: %lu s | Uptime: %lu s | Score: %.1f/100         ║\n",
            (unsigned long)metrics.timestamp,
            (unsigned long)metrics.total_uptime,
            stability_score);
-  LOG_INFO("╚════════════════════════════════════════════════════════════╝\n");
+  EVAL_INFO("╚════════════════════════════════════════════════════════════╝\n");
   
   /* RPL Status */
-  LOG_INFO("\n┌─── RPL NETWORK STATUS ───────────────────────────────────┐\n");
+  EVAL_INFO("\n┌─── RPL NETWORK STATUS ───────────────────────────────────┐\n");
   if(curr_instance.dag.state >= DAG_INITIALIZED) {
-    LOG_INFO("│ Status:          ✓ JOINED DODAG                          │\n");
-    LOG_INFO("│ Current Rank:    %-6u                                   │\n", 
+    EVAL_INFO("│ Status:          ✓ JOINED DODAG                          │\n");
+    EVAL_INFO("│ Current Rank:    %-6u                                   │\n", 
              metrics.current_rank);
-    LOG_INFO("│ Rank Range:      %u - %u                                 │\n",
+    EVAL_INFO("│ Rank Range:      %u - %u                                 │\n",
              metrics.min_rank_seen, metrics.max_rank_seen);
-    LOG_INFO("│ DODAG Version:   %-3u                                    │\n", 
+    EVAL_INFO("│ DODAG Version:   %-3u                                    │\n", 
              metrics.dodag_version);
-    LOG_INFO("│ Neighbors:       %-3lu                                    │\n", 
+    EVAL_INFO("│ Neighbors:       %-3lu                                    │\n", 
              (unsigned long)metrics.rpl_neighbors);
     
     uip_ipaddr_t *parent = rpl_neighbor_get_ipaddr(curr_instance.dag.preferred_parent);
     if(parent != NULL) {
-      LOG_INFO("│ Preferred Parent: ");
-      LOG_INFO_6ADDR(parent);
-      LOG_INFO_("                │\n");
+      EVAL_INFO("│ Preferred Parent: ");
+      EVAL_INFO_6ADDR(parent);
+      EVAL_INFO_("                │\n");
     }
   } else {
-    LOG_INFO("│ Status:          ✗ NOT IN DODAG                          │\n");
+    EVAL_INFO("│ Status:          ✗ NOT IN DODAG                          │\n");
   }
-  LOG_INFO("└──────────────────────────────────────────────────────────┘\n");
+  EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
   
   /* Network Dynamics */
-  LOG_INFO("\n┌─── NETWORK DYNAMICS ─────────────────────────────────────┐\n");
-  LOG_INFO("│ Parent Switches:    %-6lu                               │\n", 
+  EVAL_INFO("\n┌─── NETWORK DYNAMICS ─────────────────────────────────────┐\n");
+  EVAL_INFO("│ Parent Switches:    %-6lu                               │\n", 
            (unsigned long)metrics.parent_switches);
-  LOG_INFO("│ Rank Changes:       %-6lu                               │\n", 
+  EVAL_INFO("│ Rank Changes:       %-6lu                               │\n", 
            (unsigned long)metrics.rank_changes);
-  LOG_INFO("│ DODAG Joins:        %-6lu                               │\n", 
+  EVAL_INFO("│ DODAG Joins:        %-6lu                               │\n", 
            (unsigned long)metrics.dodag_joins);
-  LOG_INFO("│ DODAG Leaves:       %-6lu                               │\n", 
+  EVAL_INFO("│ DODAG Leaves:       %-6lu                               │\n", 
            (unsigned long)metrics.dodag_leaves);
-  LOG_INFO("└──────────────────────────────────────────────────────────┘\n");
+  EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
+  
+  /* Per instance and DODAG */
+  EVAL_INFO("\n┌─── RPL INSTANCES / DODAGS ───────────────────────────────┐\n");
+  for(i = 0; i < EVAL_MAX_DODAGS; i++) {
+    const dodag_metrics_t *d = &tracked_dodags[i];
+    
+    if(d->last_heard == 0) {
+      continue;
+    }
+    EVAL_INFO("│ %s inst %-3u ", d == joined_dodag &&
+             curr_instance.dag.state >= DAG_INITIALIZED ? "*" : " ",
+             d->instance_id);
+    EVAL_INFO_6ADDR(&d->dodag_id);
+    EVAL_INFO_(" v%u                   │\n", d->version);
+    EVAL_INFO("│   DIOs %-6lu best rank %-5u joined %-6lu s            │\n",
+             (unsigned long)d->dio_rx, d->best_rank,
+             (unsigned long)d->joined_time);
+    EVAL_INFO("│   rank changes %-5lu parent switches %-5lu              │\n",
+             (unsigned long)d->rank_changes,
+             (unsigned long)d->parent_switches);
+  }
+  EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
+  
+  /* Control-plane overhead */
+  EVAL_INFO("\n┌─── RPL CONTROL TRAFFIC ──────────────────────────────────┐\n");
+  for(i = 0; i < RPL_MSG_TYPES; i++) {
+    EVAL_INFO("│ %-8s rx %6lu (%7lu B)   tx %6lu (%7lu B)     │\n",
+             rpl_msg_names[i],
+             (unsigned long)rpl_msgs[i].rx, (unsigned long)rpl_msgs[i].rx_bytes,
+             (unsigned long)rpl_msgs[i].tx, (unsigned long)rpl_msgs[i].tx_bytes);
+    ctl_msgs += rpl_msgs[i].rx + rpl_msgs[i].tx;
+    ctl_rx_bytes += rpl_msgs[i].rx_bytes;
+    ctl_tx_bytes += rpl_msgs[i].tx_bytes;
+  }
+  EVAL_INFO("│ IPv6 packets:    rx %lu, tx %lu                          │\n",
+           (unsigned long)metrics.packets_received,
+           (unsigned long)metrics.packets_sent);
+  if(metrics.total_uptime > 0) {
+    EVAL_INFO("│ Overhead:        %lu msgs/min, %lu B/min                  │\n",
+             (unsigned long)((uint64_t)ctl_msgs * 60 / metrics.total_uptime),
+             (unsigned long)((uint64_t)(ctl_rx_bytes + ctl_tx_bytes) * 60 /
+                             metrics.total_uptime));
+  }
+  EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
   
   /* Connection Statistics */
-  LOG_INFO("\n┌─── CONNECTION STATISTICS ────────────────────────────────┐\n");
+  EVAL_INFO("\n┌─── CONNECTION STATISTICS ────────────────────────────────┐\n");
   if(metrics.total_uptime > 0) {
     float uptime_pct = (metrics.connected_time * 100.0) / metrics.total_uptime;
     float downtime_pct = (metrics.disconnected_time * 100.0) / metrics.total_uptime;
     
-    LOG_INFO("│ Connected Time:     %lu s (%.1f%%)                      │\n",
+    EVAL_INFO("│ Connected Time:     %lu s (%.1f%%)                      │\n",
              (unsigned long)metrics.connected_time, uptime_pct);
-    LOG_INFO("│ Disconnected Time:  %lu s (%.1f%%)                      │\n",
+    EVAL_INFO("│ Disconnected Time:  %lu s (%.1f%%)                      │\n",
              (unsigned long)metrics.disconnected_time, downtime_pct);
     
     if(metrics.dodag_joins > 0) {
       uint32_t avg_session = metrics.connected_time / metrics.dodag_joins;
-      LOG_INFO("│ Avg Session:        %lu s                               │\n",
+      EVAL_INFO("│ Avg Session:        %lu s                               │\n",
                (unsigned long)avg_session);
     }
   }
-  LOG_INFO("└──────────────────────────────────────────────────────────┘\n");
+  EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
   
   /* Energy Consumption */
-  LOG_INFO("\n┌─── ENERGY CONSUMPTION (ticks) ───────────────────────────┐\n");
-  LOG_INFO("│ CPU:       %10lu (%.1f%%)                             │\n", 
+  EVAL_INFO("\n┌─── ENERGY CONSUMPTION (ticks) ───────────────────────────┐\n");
+  EVAL_INFO("│ CPU:       %10lu (%.1f%%)                             │\n", 
            (unsigned long)metrics.energy_cpu,
            total_energy > 0 ? (metrics.energy_cpu * 100.0) / total_energy : 0);
-  LOG_INFO("│ LPM:       %10lu (%.1f%%)                             │\n", 
+  EVAL_INFO("│ LPM:       %10lu (%.1f%%)                             │\n", 
            (unsigned long)metrics.energy_lpm,
            total_energy > 0 ? (metrics.energy_lpm * 100.0) / total_energy : 0);
-  LOG_INFO("│ TX:        %10lu (%.1f%%)                             │\n", 
+  EVAL_INFO("│ TX:        %10lu (%.1f%%)                             │\n", 
            (unsigned long)metrics.energy_tx,
            total_energy > 0 ? (metrics.energy_tx * 100.0) / total_energy : 0);
-  LOG_INFO("│ RX:        %10lu (%.1f%%)                             │\n", 
+  EVAL_INFO("│ RX:        %10lu (%.1f%%)                             │\n", 
            (unsigned long)metrics.energy_rx,
            total_energy > 0 ? (metrics.energy_rx * 100.0) / total_energy : 0);
-  LOG_INFO("│ ────────────────────────────────────────────────────────│\n");
-  LOG_INFO("│ Total:     %10lu                                      │\n", 
+  EVAL_INFO("│ ────────────────────────────────────────────────────────│\n");
+  EVAL_INFO("│ Total:     %10lu                                      │\n", 
            (unsigned long)total_energy);
   
   if(energy_per_second.sample_count > 0) {
-    LOG_INFO("│ Rate:      %lu ticks/s (min: %lu, max: %lu)            │\n",
+    EVAL_INFO("│ Rate:      %lu ticks/s (min: %lu, max: %lu)            │\n",
              (unsigned long)energy_per_second.avg_value,
              (unsigned long)energy_per_second.min_value,
              (unsigned long)energy_per_second.max_value);
   }
-  LOG_INFO("└──────────────────────────────────────────────────────────┘\n");
+  EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
   
   /* Performance Statistics */
-  LOG_INFO("\n┌─── PERFORMANCE STATISTICS ───────────────────────────────┐\n");
+  EVAL_INFO("\n┌─── PERFORMANCE STATISTICS ───────────────────────────────┐\n");
   if(rank_stability.sample_count > 0) {
-    LOG_INFO("│ Rank Stats:   avg=%u, min=%u, max=%u (%lu samples)     │\n",
+    EVAL_INFO("│ Rank Stats:   avg=%u, min=%u, max=%u (%lu samples)     │\n",
              rank_stability.avg_value,
              rank_stability.min_value,
              rank_stability.max_value,
              (unsigned long)rank_stability.sample_count);
   }
   if(neighbor_stability.sample_count > 0) {
-    LOG_INFO("│ Neighbor Stats: avg=%u, min=%u, max=%u (%lu samples)   │\n",
+    EVAL_INFO("│ Neighbor Stats: avg=%u, min=%u, max=%u (%lu samples)   │\n",
              neighbor_stability.avg_value,
              neighbor_stability.min_value,
              neighbor_stability.max_value,
              (unsigned long)neighbor_stability.sample_count);
   }
-  LOG_INFO("└──────────────────────────────────────────────────────────┘\n");
+  EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
   
   /* Delta Metrics */
   if(prev_metrics.timestamp > 0) {
@@ -464,21 +1270,23 @@ print_detailed_report(void)
       (prev_metrics.energy_cpu + prev_metrics.energy_lpm + 
        prev_metrics.energy_tx + prev_metrics.energy_rx);
     
-    LOG_INFO("\n┌─── DELTA METRICS (last %lu seconds) ──────────────────────┐\n",
+    EVAL_INFO("\n┌─── DELTA METRICS (last %lu seconds) ──────────────────────┐\n",
              (unsigned long)time_delta);
-    LOG_INFO("│ Energy:         %lu ticks                               │\n", 
+    EVAL_INFO("│ Energy:         %lu ticks                               │\n", 
              (unsigned long)energy_delta);
-    LOG_INFO("│ Parent Switches: %lu                                    │\n",
+    EVAL_INFO("│ Parent Switches: %lu                                    │\n",
              (unsigned long)(metrics.parent_switches - prev_metrics.parent_switches));
-    LOG_INFO("│ Rank Changes:   %lu                                     │\n",
+    EVAL_INFO("│ Rank Changes:   %lu                                     │\n",
              (unsigned long)(metrics.rank_changes - prev_metrics.rank_changes));
-    LOG_INFO("│ DODAG Joins:    %lu                                     │\n",
+    EVAL_INFO("│ DODAG Joins:    %lu                                     │\n",
              (unsigned long)(metrics.dodag_joins - prev_metrics.dodag_joins));
-    LOG_INFO("└──────────────────────────────────────────────────────────┘\n");
+    EVAL_INFO("│ DIOs Received:  %lu                                     │\n",
+             (unsigned long)(metrics.dio_received - prev_metrics.dio_received));
+    EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
   }
   
   /* CSV Output */
-  LOG_INFO("\n[CSV] %lu,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.1f\n",
+  EVAL_INFO("\n[CSV] %lu,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.1f\n",
            (unsigned long)metrics.timestamp,
            metrics.current_rank,
            metrics.dodag_version,
@@ -492,10 +1300,51 @@ print_detailed_report(void)
            (unsigned long)total_energy,
            (unsigned long)metrics.connected_time,
            stability_score);
+  EVAL_INFO("[CTL] %lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+           (unsigned long)metrics.timestamp,
+           (unsigned long)rpl_msgs[RPL_CODE_DIO].rx,
+           (unsigned long)rpl_msgs[RPL_CODE_DIO].tx,
+           (unsigned long)rpl_msgs[RPL_CODE_DIS].rx,
+           (unsigned long)rpl_msgs[RPL_CODE_DIS].tx,
+           (unsigned long)rpl_msgs[RPL_CODE_DAO].rx,
+           (unsigned long)rpl_msgs[RPL_CODE_DAO].tx,
+           (unsigned long)rpl_msgs[RPL_CODE_DAO_ACK].rx,
+           (unsigned long)rpl_msgs[RPL_CODE_DAO_ACK].tx,
+           (unsigned long)ctl_rx_bytes, (unsigned long)ctl_tx_bytes);
+#if EVAL_CONF_WITH_PROBES
+  print_probe_report();
+#endif
   
   memcpy(&prev_metrics, &metrics, sizeof(evaluation_metrics_t));
 }
 
+/*---------------------------------------------------------------------------*/
+/* Non-empty DIO gap buckets of a neighbor, labelled by their lower bound */
+static void
+print_dio_gaps(const neighbor_info_t *info)
+{
+  uint8_t b;
+  uint32_t lower_ms;
+
+  if(info->dio_count < 2) {
+    return;
+  }
+  EVAL_INFO("│    DIO gaps:");
+  for(b = 0; b < DIO_GAP_BUCKETS; b++) {
+    if(info->dio_gaps[b] == 0) {
+      continue;
+    }
+    lower_ms = b == 0 ? 0 : (uint32_t)1 << (DIO_GAP_MIN_LOG2 + b - 1);
+    if(lower_ms < 1000) {
+      EVAL_INFO_(" >=%lums:%u", (unsigned long)lower_ms, info->dio_gaps[b]);
+    } else {
+      EVAL_INFO_(" >=%lus:%u", (unsigned long)(lower_ms / 1000),
+                 info->dio_gaps[b]);
+    }
+  }
+  EVAL_INFO_("\n");
+}
+
 /*---------------------------------------------------------------------------*/
 static void
 print_neighbor_details(void)
@@ -504,11 +1353,11 @@ print_neighbor_details(void)
   uint32_t current_time = (uint32_t)clock_seconds();
   
   if(curr_instance.dag.state < DAG_INITIALIZED) {
-    LOG_INFO("Not in DODAG - no neighbor information available\n");
+    EVAL_INFO("Not in DODAG - no neighbor information available\n");
     return;
   }
   
-  LOG_INFO("\n┌─── NEIGHBOR DETAILS ─────────────────────────────────────┐\n");
+  EVAL_INFO("\n┌─── NEIGHBOR DETAILS ─────────────────────────────────────┐\n");
   
   for(i = 0; i < MAX_TRACKED_NEIGHBORS; i++) {
     if(tracked_neighbors[i].last_seen > 0) {
@@ -518,52 +1367,98 @@ print_neighbor_details(void)
       if(age < 300) { /* Active within last 5 minutes */
         active_count++;
         
-        LOG_INFO("│ %d. ", active_count);
-        LOG_INFO_6ADDR(&tracked_neighbors[i].addr);
-        LOG_INFO_("\n");
-        LOG_INFO("│    Rank: %u | DIOs: %lu | Age: %lus | Duration: %lus\n",
+        EVAL_INFO("│ %d. ", active_count);
+        EVAL_INFO_6ADDR(&tracked_neighbors[i].addr);
+        EVAL_INFO_("\n");
+        EVAL_INFO("│    Rank: %u | DIOs: %lu | Age: %lus | Duration: %lus\n",
                  tracked_neighbors[i].rank,
                  (unsigned long)tracked_neighbors[i].dio_count,
                  (unsigned long)age,
                  (unsigned long)duration);
+        EVAL_INFO("│    DIS: %u | DAO: %u\n",
+                 tracked_neighbors[i].dis_count,
+                 tracked_neighbors[i].dao_count);
+        print_dio_gaps(&tracked_neighbors[i]);
         
         if(tracked_neighbors[i].is_parent) {
-          LOG_INFO("│    [CURRENT PARENT]\n");
+          EVAL_INFO("│    [CURRENT PARENT]\n");
         } else if(tracked_neighbors[i].was_parent) {
-          LOG_INFO("│    [FORMER PARENT]\n");
+          EVAL_INFO("│    [FORMER PARENT]\n");
         }
-        LOG_INFO("│\n");
+        EVAL_INFO("│\n");
       }
     }
   }
   
   if(active_count == 0) {
-    LOG_INFO("│ No active neighbors                                      │\n");
+    EVAL_INFO("│ No active neighbors                                      │\n");
   }
   
-  LOG_INFO("└──────────────────────────────────────────────────────────┘\n");
+  EVAL_INFO("└──────────────────────────────────────────────────────────┘\n");
 }
 
 /*---------------------------------------------------------------------------*/
 static void
 print_summary_stats(void)
 {
-  LOG_INFO("\n");
-  LOG_INFO("╔════════════════════════════════════════════════════════════╗\n");
-  LOG_INFO("║                  SUMMARY STATISTICS                        ║\n");
-  LOG_INFO("╚════════════════════════════════════════════════════════════╝\n");
-  LOG_INFO("CSV Header: time,rank,ver,nbr,parent_sw,rank_ch,cpu,lpm,tx,rx,total,conn_time,score\n");
-  LOG_INFO("\n");
-  LOG_INFO("Total Runtime:       %lu seconds\n", 
+  EVAL_INFO("\n");
+  EVAL_INFO("╔════════════════════════════════════════════════════════════╗\n");
+  EVAL_INFO("║                  SUMMARY STATISTICS                        ║\n");
+  EVAL_INFO("╚════════════════════════════════════════════════════════════╝\n");
+  EVAL_INFO("CSV Header: time,rank,ver,nbr,parent_sw,rank_ch,cpu,lpm,tx,rx,total,conn_time,score\n");
+  EVAL_INFO("CTL Header: time,dio_rx,dio_tx,dis_rx,dis_tx,dao_rx,dao_tx,ack_rx,ack_tx,bytes_rx,bytes_tx\n");
+#if EVAL_CONF_WITH_PROBES
+  EVAL_INFO("PRB Header: clock_ms,sent,no_route,echoed,lost,ooo,dup,period_echoed,rtt_p50,rtt_p90,rtt_p99\n");
+#endif
+#if EVAL_CONF_WITH_HISTORY
+  EVAL_INFO("HST Header: start_s,period_s,samples,hex (send \"history\" to dump)\n");
+#endif
+  EVAL_INFO("\n");
+  EVAL_INFO("Total Runtime:       %lu seconds\n", 
            (unsigned long)metrics.total_uptime);
-  LOG_INFO("Stability Score:     %.1f / 100\n", calculate_stability_score());
-  LOG_INFO("Network Efficiency:  %lu rank changes, %lu parent switches\n",
+  EVAL_INFO("Stability Score:     %.1f / 100\n", calculate_stability_score());
+  EVAL_INFO("Network Efficiency:  %lu rank changes, %lu parent switches\n",
            (unsigned long)metrics.rank_changes,
            (unsigned long)metrics.parent_switches);
-  LOG_INFO("Connection Quality:  %.1f%% uptime\n",
+  EVAL_INFO("Connection Quality:  %.1f%% uptime\n",
            metrics.total_uptime > 0 ? 
            (metrics.connected_time * 100.0) / metrics.total_uptime : 0);
-  LOG_INFO("════════════════════════════════════════════════════════════\n");
+  EVAL_INFO("Scheduler:           %lu ticks, %lu writes, %lu us CPU/tick\n",
+           (unsigned long)tick_count, (unsigned long)eval_out_writes,
+           tick_count > 0 ? (unsigned long)((uint64_t)tick_cpu_ticks *
+                                            1000000 / RTIMER_SECOND /
+                                            tick_count) : 0);
+#if EVAL_CONF_WITH_HISTORY
+  EVAL_INFO("History:             %lu samples, %lu B encoded (%lu.%02lu B/sample), %u B RAM\n",
+           (unsigned long)history_samples, (unsigned long)history_bytes,
+           (unsigned long)(history_samples > 0 ?
+                           history_bytes / history_samples : 0),
+           (unsigned long)(history_samples > 0 ?
+                           history_bytes * 100 / history_samples % 100 : 0),
+           (unsigned)sizeof(history));
+#endif
+  EVAL_INFO("════════════════════════════════════════════════════════════\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* Collect once and run every report that is due at this tick */
+static void
+eval_tick(void)
+{
+  rtimer_clock_t start = RTIMER_NOW();
+
+  tick_count++;
+  update_rpl_metrics();
+  if(tick_count % REPORT_TICKS == 0) {
+    update_energy_metrics();
+    print_detailed_report();
+  }
+  if(tick_count % NEIGHBOR_TICKS == 0) {
+    print_neighbor_details();
+    print_summary_stats();
+  }
+  tick_cpu_ticks += RTIMER_NOW() - start;
+  eval_flush();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -573,41 +1468,66 @@ AUTOSTART_PROCESSES(&dio_evaluator_process);
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(dio_evaluator_process, ev, data)
 {
-  static struct etimer report_timer;
-  static struct etimer update_timer;
-  static struct etimer neighbor_timer;
+  static struct etimer tick_timer;
   
   PROCESS_BEGIN();
   
   init_metrics();
   energest_init();
+  netstack_ip_packet_processor_add(&rpl_tap_processor);
+#if EVAL_CONF_WITH_PROBES
+  probe_init();
+#endif
+  last_update_time = metrics.start_time;
   
-  LOG_INFO("Detailed reports every 2 minutes\n");
-  LOG_INFO("Quick updates every 30 seconds\n");
-  LOG_INFO("Neighbor analysis every 5 minutes\n");
+  EVAL_INFO("Detailed reports every %u seconds\n", EVAL_TICK * REPORT_TICKS);
+  EVAL_INFO("Quick updates every %u seconds\n", EVAL_TICK);
+  EVAL_INFO("Neighbor analysis every %u seconds\n", EVAL_TICK * NEIGHBOR_TICKS);
+#if EVAL_CONF_WITH_PROBES
+  EVAL_INFO("Probes to the root every %u seconds\n", PROBE_INTERVAL);
+#endif
+#if EVAL_CONF_WITH_HISTORY
+  EVAL_INFO("History sampled every %u seconds, %u B\n",
+           EVAL_HISTORY_PERIOD, EVAL_HISTORY_SIZE);
+#endif
+  eval_flush();
   
-  etimer_set(&report_timer, CLOCK_SECOND * 120);   /* 2 min - detailed report */
-  etimer_set(&update_timer, CLOCK_SECOND * 30);    /* 30 sec - quick update */
-  etimer_set(&neighbor_timer, CLOCK_SECOND * 300); /* 5 min - neighbor details */
+  etimer_set(&tick_timer, CLOCK_SECOND * EVAL_TICK);
+#if EVAL_CONF_WITH_PROBES
+  probe_schedule();
+#endif
+#if EVAL_CONF_WITH_HISTORY
+  etimer_set(&history_timer, CLOCK_SECOND * EVAL_HISTORY_PERIOD);
+#endif
   
   while(1) {
     PROCESS_WAIT_EVENT();
-    
-    if(etimer_expired(&report_timer)) {
-      print_detailed_report();
-      etimer_reset(&report_timer);
+#if EVAL_CONF_WITH_HISTORY
+    if(ev == serial_line_event_message &&
+       strcmp((const char *)data, "history") == 0) {
+      history_dump();
+      continue;
     }
-    
-    if(etimer_expired(&update_timer)) {
-      update_rpl_metrics();
-      etimer_reset(&update_timer);
+    if(ev == PROCESS_EVENT_TIMER && data == &history_timer &&
+       etimer_expired(&history_timer)) {
+      history_sample();
+      etimer_reset(&history_timer);
+      continue;
     }
-    
-    if(etimer_expired(&neighbor_timer)) {
-      print_neighbor_details();
-      print_summary_stats();
-      etimer_reset(&neighbor_timer);
+#endif
+    if(ev != PROCESS_EVENT_TIMER) {
+      continue;
+    }
+    if(data == &tick_timer && etimer_expired(&tick_timer)) {
+      eval_tick();
+      etimer_reset(&tick_timer);
+    }
+#if EVAL_CONF_WITH_PROBES
+    if(data == &probe_timer && etimer_expired(&probe_timer)) {
+      probe_send();
+      probe_schedule();
     }
+#endif
   }
   
   PROCESS_END();
@@ -5,48 +5,350 @@
 #include "net/routing/rpl-lite/rpl-icmp6.h"
 #include "net/ipv6/uip.h"
 #include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/uipbuf.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
 #include "sys/log.h"
+#include "sys/energest.h"
 #include "random.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#include <stddef.h>
+#include <stdlib.h>
+
+PROCESS_NAME(dio_mitigation_process);
+
+/* Runtime configuration front-ends */
+#ifndef MITIGATION_CONF_WITH_SHELL
+#define MITIGATION_CONF_WITH_SHELL 0 /* Needs MODULES += os/services/shell */
+#endif
+#ifndef MITIGATION_CONF_WITH_CFS
+#define MITIGATION_CONF_WITH_CFS 0   /* Needs MODULES += os/storage/cfs */
+#endif
+#ifndef MITIGATION_CONF_WITH_GROUND_TRUTH
+#define MITIGATION_CONF_WITH_GROUND_TRUTH 0 /* Evaluation builds only */
+#endif
+#ifndef MITIGATION_CONF_LOW_POWER
+#define MITIGATION_CONF_LOW_POWER 1 /* Idle-aware housekeeping schedule */
+#endif
+#ifndef MITIGATION_CONF_WITH_LL_FILTER
+#define MITIGATION_CONF_WITH_LL_FILTER 0 /* Drop blacklisted senders' frames
+                                          * before 6LoWPAN decompression */
+#endif
+/* Trickle reset damping runs from rpl-lite's new-interval callback; the
+ * build names it, e.g. DEFINES=RPL_CALLBACK_NEW_DIO_INTERVAL=mitigation_dio_interval */
+#ifdef RPL_CALLBACK_NEW_DIO_INTERVAL
+#define MITIGATION_TRICKLE_HOOK 1
+#else
+#define MITIGATION_TRICKLE_HOOK 0
+#endif
+
+#if MITIGATION_CONF_WITH_SHELL
+#include "shell.h"
+#include "shell-commands.h"
+#endif
+#if MITIGATION_CONF_WITH_CFS
+#include "cfs/cfs.h"
+#endif
+#if MITIGATION_CONF_WITH_LL_FILTER
+#ifndef NETSTACK_CONF_NETWORK
+#error "MITIGATION_CONF_WITH_LL_FILTER needs NETSTACK_CONF_NETWORK=mitigation_network_driver"
+#endif
+#include "net/ipv6/sicslowpan.h"
+#endif
 
 #define LOG_MODULE "DIO-Mitigation"
 #define LOG_LEVEL LOG_LEVEL_INFO
 
-/* Replay detection parameters */
-#define DIO_CACHE_SIZE 30
+/* Replay detection parameters (boot defaults, tunable at runtime;
+ * the defaults can also be overridden per build with DEFINES=) */
+#define DIO_CACHE_SIZE 30 /* Most fingerprints held at once */
+#ifndef DIO_TIMESTAMP_WINDOW
 #define DIO_TIMESTAMP_WINDOW 300
-#define MONITORING_INTERVAL (CLOCK_SECOND * 2)
+#endif
+#ifndef MONITORING_INTERVAL
+#define MONITORING_INTERVAL 2 /* Seconds between detector housekeeping ticks */
+#endif
+#ifndef MAX_DIO_RATE
+#define MAX_DIO_RATE 3        /* DIOs/sec above which a sender is flagged */
+#endif
+#ifndef DUPLICATE_WINDOW
+#define DUPLICATE_WINDOW 5    /* Seconds within which a repeat is a replay */
+#endif
 
 /* Blacklist parameters */
-#define BLACKLIST_SIZE 10
+#define BLACKLIST_SIZE 10 /* Most entries held at once */
+#ifndef BLACKLIST_THRESHOLD
 #define BLACKLIST_THRESHOLD 5  /* Number of violations before blacklisting */
+#endif
+#ifndef BLACKLIST_DURATION
 #define BLACKLIST_DURATION 600 /* Time in seconds to keep node blacklisted */
+#endif
+#ifndef AUTO_BLACKLIST_ENABLED
 #define AUTO_BLACKLIST_ENABLED 1 /* Auto-blacklist on threshold */
+#endif
+#ifndef QUARANTINE_THRESHOLD
+#define QUARANTINE_THRESHOLD 2 /* Violations before parent quarantine, 0: off */
+#endif
+#ifndef QUARANTINE_MARGIN
+#define QUARANTINE_MARGIN 384  /* Path cost a quarantined parent must win by */
+#endif
+#ifndef TRICKLE_RESET_BUDGET
+#define TRICKLE_RESET_BUDGET 2   /* Resets one sender may cause per window, 0: off */
+#endif
+#ifndef TRICKLE_RESET_WINDOW
+#define TRICKLE_RESET_WINDOW 600 /* Seconds */
+#endif
+#ifndef MAX_DIS_PER_WINDOW
+#define MAX_DIS_PER_WINDOW 5   /* DIS per sender per CTL_RATE_WINDOW */
+#endif
+#ifndef MAX_DAO_PER_WINDOW
+#define MAX_DAO_PER_WINDOW 5   /* DAOs per origin per CTL_RATE_WINDOW */
+#endif
 
-/* Cache entry */
+/* Entry pool shared by the node, blacklist and fingerprint tables. The
+ * table sizes are caps; the pool is the RAM actually reserved. */
+#ifndef MITIGATION_CONF_POOL_BLOCKS
+#define MITIGATION_CONF_POOL_BLOCKS 32
+#endif
+
+/* Detection policies */
+#define POLICY_STATIC 0   /* Fixed thresholds from the configuration */
+#define POLICY_ADAPTIVE 1 /* Thresholds follow EWMA baselines and churn */
+#ifndef DETECTION_POLICY
+#define DETECTION_POLICY POLICY_STATIC
+#endif
+
+/* Adaptive policy parameters */
+#define EWMA_SHIFT 3           /* EWMA weight 1/8 */
+#define INTERVAL_FRAC_BITS 4   /* Intervals kept in 1/16 s */
+#define CHURN_RANK_EVENT 16    /* Churn added by a neighbor rank change */
+#define CHURN_VERSION_EVENT 64 /* Churn added by a DODAG version change */
+#define CHURN_HIGH 32          /* Above this, repeats are legitimate resets */
+#define CHURN_UNIT 16          /* Churn per extra DIO/s allowed */
+#define CHURN_MAX 1024
+#define ADAPTIVE_MIN_SAMPLES 4 /* Intervals needed before a baseline is used */
+
+/* Plausibility filter: largest same-version rank drop, in MinHopRankIncrease */
+#define RANK_JUMP_HOPS 3
+
+/* Trickle reset damping: airtime of one DIO, for the TX energy saved */
+#define DIO_FRAME_OVERHEAD 27 /* PHY 6, MAC header and FCS 17, IPHC 4 bytes */
+#define TX_US_PER_BYTE 32     /* 802.15.4 O-QPSK, 250 kbit/s */
+
+/* DIS and DAO screening */
+#define CTL_DIS 0
+#define CTL_DAO 1
+#define CTL_TYPES 2
+#define CTL_RATE_WINDOW 10     /* Seconds */
+#define DAO_MAX_REPEATS 6      /* Copies of one DAO sequence: 1 + retransmissions */
+#define DAO_SEQ_OFFSET 3       /* Instance, flags, reserved, then sequence */
+
+/* Burst coalescing: copies of one DIO from one sender within Imin/2 */
+#ifndef BURST_SLOTS
+#define BURST_SLOTS 4          /* Bursts followed at once */
+#endif
+
+/* Signal profile: RSSI/LQI a neighbor's own DIOs arrive with */
+#define SIGNAL_FRAC_BITS 4     /* Profiles kept in 1/16 dB and 1/16 LQI */
+#define SIGNAL_RSSI_OFFSET 128 /* Keeps dBm positive in the EWMA */
+#define SIGNAL_MIN_SAMPLES 4   /* Accepted DIOs before a profile is used */
+#define SIGNAL_DEV_K 4         /* Mean deviations a DIO may stray */
+#define SIGNAL_RSSI_FLOOR 5    /* dB always tolerated, covers fading */
+#define SIGNAL_LQI_FLOOR 12    /* LQI always tolerated */
+#define SIGNAL_STALE 1800      /* Seconds unheard before a profile is relearned */
+
+/* Blacklist digest parameters (piggybacked on outgoing DIOs) */
+#define RPL_OPTION_BLACKLIST_DIGEST 0x20 /* Unassigned RPL option type */
+#define DIGEST_BLOOM_BITS 128
+#define DIGEST_BLOOM_HASHES 3
+#define DIGEST_OPTION_LEN (2 + DIGEST_BLOOM_BITS / 8) /* gen + entries + bloom */
+#define DIGEST_NEIGHBORS 4 /* Remote digests kept for merging */
+#define DIGEST_EMPTY_REPEATS 3 /* DIOs still tagged after the list empties */
+#define DIGEST_MIN_ORIGINS 2 /* Neighbors whose digests must list a sender */
+#define DIGEST_RESYNC 120  /* Seconds without a newer digest before an
+                            * origin's generation is relearned */
+
+/* Housekeeping schedule. In low-power mode the detector tick doubles on
+ * every quiet tick, up to the idle cap when no DIO arrived at all, and
+ * drops back to the monitoring interval on the first flagged DIO */
+#define STATS_INTERVAL 30          /* Seconds between statistics reports */
+#define BLACKLIST_PRINT_INTERVAL 60 /* Seconds between blacklist tables */
+#define SCHED_ACTIVE_TICK_MAX 8    /* Cap while clean DIOs keep arriving */
+#define SCHED_IDLE_TICK_MAX 32     /* Cap while the neighborhood is silent */
+
+/* Ground-truth instrumentation: dessim marks the frames its attackers
+ * replay with this IPv6 flow label */
+#define GROUND_TRUTH_FLOW_LABEL 0xBADD1
+#define GT_HIST_BUCKETS 20 /* log2 ms buckets, the last one open-ended */
+
+/* Runtime configuration access */
+#define CONFIG_FILE "mitcfg"
+#define CONFIG_MAGIC 0x4D47 /* Bumped when the layout changes */
+
+/* Blacklist and neighbor summaries checkpointed across reboots */
+#define STATE_FILE "mitstate"
+#define STATE_MAGIC 0x4D55          /* Bumped when the layout changes */
+#define STATE_MIN_GAP 10            /* Seconds between blacklist checkpoints */
+#define STATE_SUMMARY_INTERVAL 300  /* Seconds between counter-only ones */
+
+/* Detection thresholds, initialized from the macros above */
+typedef struct {
+  uint16_t blacklist_threshold;
+  uint16_t blacklist_duration;
+  uint16_t monitoring_interval;
+  uint16_t timestamp_window;
+  uint16_t max_dio_rate;
+  uint16_t duplicate_window;
+  uint16_t auto_blacklist;
+  uint16_t policy;
+  uint16_t quarantine_threshold;
+  uint16_t quarantine_margin;
+  uint16_t reset_budget;
+  uint16_t reset_window;
+  uint16_t max_dis;
+  uint16_t max_dao;
+} mitigation_config_t;
+
+static mitigation_config_t cfg;
+
+#if MITIGATION_CONF_WITH_SHELL || MITIGATION_CONF_WITH_CFS
+/* Name and bounds of each tunable field */
 typedef struct {
+  const char *name;
+  uint8_t offset;
+  uint16_t min;
+  uint16_t max;
+} config_field_t;
+
+static const config_field_t config_fields[] = {
+  { "bl_threshold", offsetof(mitigation_config_t, blacklist_threshold), 1, 255 },
+  { "bl_duration", offsetof(mitigation_config_t, blacklist_duration), 1, 65535 },
+  { "monitor", offsetof(mitigation_config_t, monitoring_interval), 1, 3600 },
+  { "window", offsetof(mitigation_config_t, timestamp_window), 1, 65535 },
+  { "max_rate", offsetof(mitigation_config_t, max_dio_rate), 1, 255 },
+  { "dup_window", offsetof(mitigation_config_t, duplicate_window), 0, 3600 },
+  { "auto_bl", offsetof(mitigation_config_t, auto_blacklist), 0, 1 },
+  { "policy", offsetof(mitigation_config_t, policy), POLICY_STATIC, POLICY_ADAPTIVE },
+  { "q_threshold", offsetof(mitigation_config_t, quarantine_threshold), 0, 255 },
+  { "q_margin", offsetof(mitigation_config_t, quarantine_margin), 0, 65535 },
+  { "reset_budget", offsetof(mitigation_config_t, reset_budget), 0, 255 },
+  { "reset_window", offsetof(mitigation_config_t, reset_window), 1, 65535 },
+  { "dis_limit", offsetof(mitigation_config_t, max_dis), 1, 255 },
+  { "dao_limit", offsetof(mitigation_config_t, max_dao), 1, 255 },
+};
+
+#define CONFIG_FIELD_COUNT (sizeof(config_fields) / sizeof(config_fields[0]))
+#endif /* MITIGATION_CONF_WITH_SHELL || MITIGATION_CONF_WITH_CFS */
+
+/* Cache entry */
+typedef struct dio_cache_entry {
+  struct dio_cache_entry *next;
   uip_ipaddr_t sender;
+  uint32_t fingerprint;
   uint32_t timestamp;
   uint16_t rank;
   uint8_t version;
   uint8_t dio_count;
-  uint8_t valid;
 } dio_cache_entry_t;
 
-static dio_cache_entry_t dio_cache[DIO_CACHE_SIZE];
-static uint8_t cache_index = 0;
+LIST(dio_cache);
 
 /* Blacklist entry */
-typedef struct {
+typedef struct blacklist_entry {
+  struct blacklist_entry *next;
   uip_ipaddr_t addr;
   uint32_t blacklist_time;
   uint32_t violation_count;
   uint8_t permanent;
-  uint8_t active;
   char reason[32];
 } blacklist_entry_t;
 
-static blacklist_entry_t blacklist[BLACKLIST_SIZE];
-static uint8_t blacklist_count = 0;
+LIST(blacklist);
+
+/* RPL instance and DODAG a DIO belongs to. Detector state is kept per
+ * sender and DODAG, so a neighbor in several instances, or a neighbor
+ * DODAG, is never compared against another DODAG's history. */
+#define MAX_DODAGS 4 /* Most DODAGs tracked at once; the rest share one entry */
+
+typedef struct dodag_entry {
+  struct dodag_entry *next;
+  uip_ipaddr_t dodag_id;
+  uint8_t instance_id;
+  uint8_t version;     /* Newest version accepted */
+  uint32_t last_heard;
+  uint32_t dios;
+  uint32_t flagged;
+} dodag_entry_t;
+
+LIST(dodags);
+static dodag_entry_t dodag_other; /* Overflow key when the table is full */
+
+/* What changed since the last checkpoint */
+#define STATE_DIRTY_SUMMARY 1   /* Counters only; written lazily */
+#define STATE_DIRTY_BLACKLIST 2 /* Entry added or removed; written soon */
+static uint8_t state_dirty = 0;
+#if MITIGATION_CONF_WITH_CFS
+static uint32_t state_last_write = 0;
+static uint32_t state_writes = 0;
+static uint32_t state_bytes = 0;
+static uint32_t state_write_errors = 0;
+#endif
+
+/* Versioned Bloom filter of blacklisted IIDs */
+typedef struct {
+  uint8_t generation;
+  uint8_t entries;
+  uint8_t bloom[DIGEST_BLOOM_BITS / 8];
+} blacklist_digest_t;
+
+static blacklist_digest_t local_digest;
+static uint8_t digest_empty_repeats = 0;
+
+/* Latest digest heard from a neighbor */
+typedef struct {
+  uip_ipaddr_t origin;
+  uint32_t last_heard;   /* Last digest taken from it */
+  blacklist_digest_t digest;
+  uint8_t valid;
+} remote_digest_t;
+
+static remote_digest_t remote_digests[DIGEST_NEIGHBORS];
+
+/* Parsed DIO base object */
+#define DIO_BASE_LEN 24
+
+typedef struct {
+  uip_ipaddr_t sender;
+  uip_ipaddr_t dodag_id;
+  uint16_t rank;
+  uint8_t instance_id;
+  uint8_t version;
+  uint8_t *options;
+  uint16_t options_len;
+  dodag_entry_t *dodag;
+} dio_info_t;
+
+/* Copies of one DIO heard within one burst window. The original and the
+ * first repeat go through the detectors; later copies replay the repeat's
+ * hits and violations, and rerun only the checks that count per copy. */
+typedef struct {
+  uip_ipaddr_t sender;
+  uint32_t fingerprint;
+  clock_time_t first;  /* Arrival of the original */
+  uint16_t copies;     /* Including the original */
+  uint16_t coalesced;  /* Copies that skipped the detectors */
+  uint16_t hits;       /* Detectors, by bit, that flagged the first repeat */
+  uint8_t verdict;     /* Verdict of the first repeat */
+  uint8_t violations;  /* Violations the repeat recorded outside the rate
+                        * detector, which reruns per copy */
+} burst_entry_t;
+
+static burst_entry_t bursts[BURST_SLOTS];
+static uint32_t burst_records = 0;    /* Bursts with coalesced copies */
+static uint32_t burst_coalesced = 0;  /* DIOs judged without the detectors */
+static uint32_t burst_ticks = 0;      /* Tap time spent on those */
+static uint32_t violations_total = 0;
 
 /* Statistics */
 static uint32_t dio_received = 0;
@@ -54,329 +356,3111 @@ static uint32_t dio_accepted = 0;
 static uint32_t dio_replayed = 0;
 static uint32_t dio_suspicious = 0;
 static uint32_t dio_blocked_blacklist = 0;
+static uint32_t dio_dropped = 0;
+
+/* DIS and DAO screening, per message type */
+typedef struct {
+  uint32_t received;
+  uint32_t rate_drops;   /* Over the per-sender limit */
+  uint32_t replay_drops; /* Stale or over-repeated DAO sequence */
+  uint32_t blocked;      /* From blacklisted senders */
+  uint32_t untracked;    /* No stats entry free; passed unjudged */
+  uint32_t ticks;        /* Tap time spent on the type */
+} ctl_counters_t;
+
+static const char *const ctl_names[CTL_TYPES] = { "DIS", "DAO" };
+static ctl_counters_t ctl_counters[CTL_TYPES];
+static uint32_t ctl_forwarded = 0; /* DAOs for another node, passed on */
+static uint32_t plaus_stale_version = 0;
+static uint32_t plaus_bad_rank = 0;
+static uint32_t plaus_rank_jump = 0;
+static uint32_t rank_passed = 0;
+static uint32_t signal_checked = 0;
+static uint32_t signal_rssi_hits = 0;
+static uint32_t signal_lqi_hits = 0;
+static uint32_t signal_relearned = 0;
 static uint32_t nodes_blacklisted = 0;
 
-/* Node tracking for behavioral analysis */
-typedef struct {
-  uip_ipaddr_t sender;
-  uint32_t last_seen;
-  uint16_t last_rank;
-  uint8_t last_version;
-  uint8_t dio_count_per_sec;
-  uint32_t last_count_reset;
-  uint32_t violation_count;
-} node_stats_t;
+#if MITIGATION_CONF_WITH_LL_FILTER
+/* Link-layer deny set, one entry per blacklisted link-local sender */
+typedef struct {
+  linkaddr_t addr;
+  const blacklist_entry_t *entry;
+} ll_deny_t;
+
+static ll_deny_t ll_deny[BLACKLIST_SIZE];
+static uint8_t ll_deny_count = 0;
+static uint32_t ll_frames = 0;       /* Frames through the filter */
+static uint32_t ll_dropped = 0;      /* Frames dropped before decompression */
+static uint32_t ll_drop_ticks = 0;   /* Filter time spent on dropped frames */
+static uint32_t ll_tap_drops = 0;    /* Frames the IP tap later dropped */
+static uint32_t ll_tap_drop_ticks = 0; /* Full input path time for those */
+#endif
+
+/* A/B counters, matching the baseline firmware's [AB] line */
+static uint32_t tap_ticks = 0;
+static uint32_t trickle_resets = 0;
+static uint32_t parent_changes = 0;
+static uint8_t pre_dio_intcurrent = 0;
+static rpl_nbr_t *pre_dio_parent = NULL;
+static uip_ipaddr_t pre_dio_sender;
+
+/* Trickle reset damping */
+#define DAMP_IDLE 0   /* No accepted DIO inside rpl-lite */
+#define DAMP_DIO 1    /* rpl-lite is processing a DIO we accepted */
+#define DAMP_EXEMPT 2 /* Same, but it is allowed to reset Trickle */
+static uint8_t damp_cause = DAMP_IDLE;
+#if MITIGATION_TRICKLE_HOOK
+static uint8_t damp_intcurrent = 0;   /* Interval rpl-lite last started */
+#endif
+static uint32_t resets_exempt = 0;    /* New version or preferred parent */
+static uint32_t resets_damped = 0;
+static uint32_t damp_dios_saved = 0;  /* DIO transmissions not made */
+static uint32_t damp_first = 0;       /* First damped reset, seconds */
+static uint32_t dio_tx_bytes = 0;     /* Our DIOs, IPv6 length */
+
+/* Parent quarantine: the instance's objective function, with best_parent
+ * wrapped so suspects cannot easily take over as preferred parent */
+static rpl_of_t *quarantine_base = NULL;
+static rpl_of_t quarantine_of;
+static uint32_t quarantine_held = 0;    /* Selections that kept the parent */
+static uint32_t quarantine_yielded = 0; /* Suspect won by the margin anyway */
+static uint64_t last_cpu, last_lpm, last_tx, last_rx;
+static uint32_t last_report_time = 0;
+
+/* Housekeeping scheduler: one etimer for ticks and reports */
+static struct etimer sched_timer;
+static uint16_t sched_tick;           /* Current tick length, seconds */
+static clock_time_t sched_last_tick;
+static clock_time_t sched_last_stats;
+static clock_time_t sched_last_blacklist;
+static uint32_t sched_dio_mark;       /* dio_received at the last tick */
+static uint32_t sched_drop_mark;      /* dio_dropped at the last tick */
+static uint32_t sched_wakeups = 0;
+static uint8_t sched_alert = 0;       /* Flagged DIO while backed off */
+
+#if MITIGATION_CONF_WITH_GROUND_TRUTH
+/* Verdicts scored against the replay label */
+typedef struct {
+  uint32_t tp, fp, tn, fn;
+  clock_time_t first_replay;
+  clock_time_t first_detection;
+  clock_time_t first_blacklist;
+  uint32_t latency_hist[GT_HIST_BUCKETS];
+} ground_truth_t;
+
+static ground_truth_t gt;
+#endif
+
+/* Digest statistics */
+static uint32_t digest_dios_sent = 0;
+static uint32_t digest_dios_tagged = 0;
+static uint32_t digest_bytes_added = 0;
+static uint32_t digest_received = 0;
+static uint32_t digest_merged = 0;
+static uint32_t digest_rejected = 0; /* Bloom filter inconsistent with its count */
+static uint32_t digest_remote_hits = 0;
+
+/* DIS or DAO history of one sender */
+typedef struct {
+  uint32_t window_start; /* Current rate window, seconds; 0 if never heard */
+  uint8_t count;         /* Messages in the window */
+  uint8_t last_seq;      /* Newest DAO sequence */
+  uint8_t repeats;       /* Copies of last_seq seen, 0 before the first DAO */
+} ctl_stats_t;
+
+/* Node tracking for behavioral analysis */
+typedef struct node_stats {
+  struct node_stats *next;
+  uip_ipaddr_t sender;
+  dodag_entry_t *dodag;   /* NULL for a sender heard only in DIS/DAO */
+  uint32_t last_seen;
+  clock_time_t last_arrival;
+  uint16_t last_rank;
+  uint8_t last_version;
+  uint8_t dio_count_per_sec;
+  uint32_t last_count_reset;
+  uint32_t violation_count;
+  uint32_t last_violation;
+  uint32_t reset_window_start; /* Trickle resets this sender caused */
+  uint8_t reset_count;
+  uint32_t interval_ewma; /* Honest DIO inter-arrival, 1/16 s */
+  uint8_t samples;
+  uint8_t signal_samples;
+  uint16_t rssi_ewma;     /* dBm + SIGNAL_RSSI_OFFSET, fixed point */
+  uint16_t rssi_dev;      /* Mean absolute deviation, same unit */
+  uint16_t lqi_ewma;
+  uint16_t lqi_dev;
+  uint32_t signal_heard;  /* Last accepted DIO with radio metadata */
+  ctl_stats_t ctl[CTL_TYPES];
+#if MITIGATION_CONF_WITH_GROUND_TRUTH
+  clock_time_t gt_first_replay; /* First labelled replay of this sender */
+  uint8_t gt_detected;
+#endif
+} node_stats_t;
+
+#define MAX_NODES 10 /* Most senders tracked at once */
+LIST(node_stats);
+
+/* Pool tables, and eviction priorities from first to last evicted. A new
+ * entry may only displace entries of its own priority or lower, so a
+ * stream of fresh source addresses cannot flush suspects or blacklist
+ * entries out of the tables. */
+#define POOL_STATS 0
+#define POOL_BLACKLIST 1
+#define POOL_CACHE 2
+#define POOL_DODAG 3
+#define POOL_TABLES 4
+
+#define PRIO_CONTROL 0   /* Sender heard only in DIS/DAO, never a DIO */
+#define PRIO_CACHE 1     /* Fingerprints, cheap to relearn */
+#define PRIO_LISTED 2    /* Stats of a blacklisted sender; the entry decides */
+#define PRIO_BENIGN 3    /* Sender without violations */
+#define PRIO_SUSPECT 4   /* Sender with recent violations */
+#define PRIO_BLACKLIST 5 /* Temporary blacklist entry */
+#define PRIO_PERMANENT 6 /* Permanent blacklist entry */
+
+typedef union {
+  node_stats_t stats;
+  blacklist_entry_t blacklist;
+  dio_cache_entry_t cache;
+  dodag_entry_t dodag;
+} pool_block_t;
+
+MEMB(entry_pool, pool_block_t, MITIGATION_CONF_POOL_BLOCKS);
+
+typedef struct {
+  const char *name;
+  list_t list;
+  uint16_t cap;
+  uint16_t used;
+  uint16_t high_water;
+  uint32_t evictions;
+} pool_table_t;
+
+static pool_table_t pool_tables[POOL_TABLES];
+static uint16_t pool_used = 0;
+static uint16_t pool_high_water = 0;
+static uint32_t pool_failures = 0;  /* Allocations nothing could make room for */
+static const void *pool_pinned;     /* Entry the detector chain is using */
+static const void *pool_pinned_dodag; /* DODAG of the DIO being screened */
+
+/* Network-wide baseline for the adaptive policy */
+static uint32_t net_interval_ewma = 0;
+static uint16_t churn_score = 0;
+static uint8_t last_local_version = 0;
+
+/* Detector verdicts, by increasing severity */
+#define VERDICT_ACCEPT 0
+#define VERDICT_REPLAY 1 /* Flagged; counts towards the blacklist */
+#define VERDICT_BLOCK 2  /* Rejected outright; stops the chain */
+
+/* What a detector sees for one DIO */
+typedef struct {
+  const dio_info_t *dio;
+  node_stats_t *stats;
+  uint32_t now;
+  uint32_t time_diff;   /* Seconds since the sender's previous DIO */
+  clock_time_t arrival;
+  uint8_t first;        /* No previous DIO from this sender */
+  uint8_t unicast;      /* Probe or DIS answer, outside the Trickle timer */
+  int16_t rssi;         /* dBm from packetbuf, 0 when the radio gave none */
+  uint8_t lqi;
+} dio_ctx_t;
+
+/* Detector plugin; any callback except on_dio may be NULL */
+typedef struct {
+  const char *name;
+  void (*init)(void);
+  int (*on_dio)(dio_ctx_t *ctx);
+  void (*on_tick)(uint32_t elapsed);
+  void (*report)(void);
+} dio_detector_t;
+
+/* Cost accounting, one slot per detector */
+typedef struct {
+  uint32_t calls;
+  uint32_t hits;
+  uint32_t ticks;
+} detector_cost_t;
+
+/*---------------------------------------------------------------------------*/
+static uint32_t get_timestamp(void);
+static void blacklist_changed(void);
+static int dodag_is_current(const dodag_entry_t *dodag);
+static uint32_t dio_fingerprint(const dio_info_t *dio);
+
+/* Blacklist entry for an address, without expiring it */
+static blacklist_entry_t *
+blacklist_find(const uip_ipaddr_t *addr)
+{
+  blacklist_entry_t *entry;
+
+  for(entry = list_head(blacklist); entry != NULL;
+      entry = list_item_next(entry)) {
+    if(uip_ipaddr_cmp(&entry->addr, addr)) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+pool_init(void)
+{
+  static const char *const names[POOL_TABLES] = {
+    "Node stats", "Blacklist", "DIO cache", "DODAGs"
+  };
+  static const uint16_t caps[POOL_TABLES] = {
+    MAX_NODES, BLACKLIST_SIZE, DIO_CACHE_SIZE, MAX_DODAGS
+  };
+  int i;
+
+  memb_init(&entry_pool);
+  list_init(node_stats);
+  list_init(blacklist);
+  list_init(dio_cache);
+  list_init(dodags);
+  memset(pool_tables, 0, sizeof(pool_tables));
+  memset(&dodag_other, 0, sizeof(dodag_other));
+  pool_tables[POOL_STATS].list = node_stats;
+  pool_tables[POOL_BLACKLIST].list = blacklist;
+  pool_tables[POOL_CACHE].list = dio_cache;
+  pool_tables[POOL_DODAG].list = dodags;
+  for(i = 0; i < POOL_TABLES; i++) {
+    pool_tables[i].name = names[i];
+    pool_tables[i].cap = caps[i];
+  }
+  pool_used = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Eviction priority of an entry, and the time it was last relevant */
+static uint8_t
+pool_priority(int table, const void *entry, uint32_t *stamp)
+{
+  const node_stats_t *stats;
+  const blacklist_entry_t *listed;
+  const dodag_entry_t *dodag;
+
+  switch(table) {
+  case POOL_STATS:
+    stats = entry;
+    *stamp = stats->last_seen;
+    if(stats->dodag == NULL) {
+      *stamp = stats->ctl[CTL_DIS].window_start > stats->ctl[CTL_DAO].window_start ?
+        stats->ctl[CTL_DIS].window_start : stats->ctl[CTL_DAO].window_start;
+    }
+    if(blacklist_find(&stats->sender) != NULL) {
+      return PRIO_LISTED;
+    }
+    /* Suspicion lapses once the sender has been quiet for a blacklist term */
+    if(stats->violation_count > 0 &&
+       get_timestamp() - *stamp <= cfg.blacklist_duration) {
+      return PRIO_SUSPECT;
+    }
+    return stats->dodag == NULL ? PRIO_CONTROL : PRIO_BENIGN;
+  case POOL_DODAG:
+    dodag = entry;
+    *stamp = dodag->last_heard;
+    /* The DODAG we are in is never recycled, and one with recent replays
+     * keeps its senders' history as long as a suspect would */
+    if(dodag_is_current(dodag)) {
+      return PRIO_PERMANENT;
+    }
+    return dodag->flagged > 0 &&
+           get_timestamp() - *stamp <= cfg.blacklist_duration ?
+           PRIO_SUSPECT : PRIO_BENIGN;
+  case POOL_BLACKLIST:
+    listed = entry;
+    *stamp = listed->blacklist_time;
+    return listed->permanent ? PRIO_PERMANENT : PRIO_BLACKLIST;
+  default:
+    *stamp = ((const dio_cache_entry_t *)entry)->timestamp;
+    return PRIO_CACHE;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Return an entry to the pool */
+static void
+pool_free(int table, void *entry)
+{
+  node_stats_t *stats;
+  node_stats_t *next;
+
+  if(table == POOL_DODAG) {
+    /* Detector state is meaningless without its DODAG */
+    for(stats = list_head(node_stats); stats != NULL; stats = next) {
+      next = list_item_next(stats);
+      if(stats->dodag == entry && stats != pool_pinned) {
+        pool_free(POOL_STATS, stats);
+      } else if(stats->dodag == entry) {
+        stats->dodag = &dodag_other;
+      }
+    }
+  }
+  list_remove(pool_tables[table].list, entry);
+  memb_free(&entry_pool, entry);
+  pool_tables[table].used--;
+  pool_used--;
+  if(table == POOL_BLACKLIST) {
+    blacklist_changed();
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Evict the lowest-priority, least recently relevant entry of priority at
+ * most max_prio, from one table or (table < 0) from any */
+static int
+pool_evict(int table, uint8_t max_prio)
+{
+  int t;
+  void *entry;
+  void *victim = NULL;
+  int victim_table = 0;
+  uint8_t victim_prio = 0;
+  uint32_t victim_age = 0;
+  uint32_t now = get_timestamp();
+  uint32_t stamp;
+  uint8_t prio;
+
+  for(t = 0; t < POOL_TABLES; t++) {
+    if(table >= 0 && t != table) {
+      continue;
+    }
+    for(entry = list_head(pool_tables[t].list); entry != NULL;
+        entry = list_item_next(entry)) {
+      if(entry == pool_pinned || entry == pool_pinned_dodag) {
+        continue;
+      }
+      prio = pool_priority(t, entry, &stamp);
+      if(prio > max_prio) {
+        continue;
+      }
+      if(victim == NULL || prio < victim_prio ||
+         (prio == victim_prio && now - stamp > victim_age)) {
+        victim = entry;
+        victim_table = t;
+        victim_prio = prio;
+        victim_age = now - stamp;
+      }
+    }
+  }
+
+  if(victim == NULL) {
+    return 0;
+  }
+  if(victim_prio >= PRIO_SUSPECT) {
+    LOG_WARN("Pool full: evicting %s entry of priority %u\n",
+             pool_tables[victim_table].name, victim_prio);
+  }
+  pool_tables[victim_table].evictions++;
+  pool_free(victim_table, victim);
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Take a zeroed entry for a table, making room within the table's cap and
+ * the pool budget if needed. NULL when only higher-priority entries are
+ * left to displace. */
+static void *
+pool_alloc(int table, uint8_t prio)
+{
+  pool_table_t *t = &pool_tables[table];
+  void *entry;
+
+  if(t->used >= t->cap && !pool_evict(table, prio)) {
+    pool_failures++;
+    return NULL;
+  }
+  entry = memb_alloc(&entry_pool);
+  if(entry == NULL && pool_evict(-1, prio)) {
+    entry = memb_alloc(&entry_pool);
+  }
+  if(entry == NULL) {
+    pool_failures++;
+    return NULL;
+  }
+
+  memset(entry, 0, sizeof(pool_block_t));
+  list_add(t->list, entry);
+  if(++t->used > t->high_water) {
+    t->high_water = t->used;
+  }
+  if(++pool_used > pool_high_water) {
+    pool_high_water = pool_used;
+  }
+  return entry;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Pool occupancy per table, with high-water marks */
+static void
+print_pool(void)
+{
+  int i;
+
+  LOG_INFO("\n--- Entry Pool ---\n");
+  LOG_INFO("Budget:              %u blocks x %u B = %u B\n",
+           MITIGATION_CONF_POOL_BLOCKS, (unsigned)sizeof(pool_block_t),
+           (unsigned)(MITIGATION_CONF_POOL_BLOCKS * sizeof(pool_block_t)));
+  LOG_INFO("In use:              %u (high water %u), %lu failed allocs\n",
+           pool_used, pool_high_water, (unsigned long)pool_failures);
+  for(i = 0; i < POOL_TABLES; i++) {
+    LOG_INFO("%-12s         %u/%u (high water %u), %lu evicted\n",
+             pool_tables[i].name, pool_tables[i].used, pool_tables[i].cap,
+             pool_tables[i].high_water,
+             (unsigned long)pool_tables[i].evictions);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+init_blacklist(void)
+{
+  blacklist_entry_t *entry;
+
+  while((entry = list_head(blacklist)) != NULL) {
+    pool_free(POOL_BLACKLIST, entry);
+  }
+  memset(&local_digest, 0, sizeof(local_digest));
+  /* A rebooted node must not restart at a generation neighbors hold */
+  local_digest.generation = random_rand();
+  memset(remote_digests, 0, sizeof(remote_digests));
+  LOG_INFO("Blacklist initialized (size: %d, threshold: %d)\n", 
+           BLACKLIST_SIZE, cfg.blacklist_threshold);
+}
+
+/*---------------------------------------------------------------------------*/
+static void init_detectors(void);
+
+static void
+init_cache(void)
+{
+  pool_init();
+  init_detectors();
+  random_init(linkaddr_node_addr.u8[0]);
+  LOG_INFO("Mitigation cache initialized (size: %d)\n", DIO_CACHE_SIZE);
+}
+
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get_timestamp(void)
+{
+  return (uint32_t)clock_seconds();
+}
+
+/*---------------------------------------------------------------------------*/
+#if MITIGATION_CONF_WITH_SHELL || MITIGATION_CONF_WITH_CFS
+/* Field accessor for the configuration table */
+static uint16_t *
+config_value(const config_field_t *field)
+{
+  return (uint16_t *)((uint8_t *)&cfg + field->offset);
+}
+#endif
+
+/*---------------------------------------------------------------------------*/
+/* Restore compile-time defaults */
+static void
+config_defaults(void)
+{
+  cfg.blacklist_threshold = BLACKLIST_THRESHOLD;
+  cfg.blacklist_duration = BLACKLIST_DURATION;
+  cfg.monitoring_interval = MONITORING_INTERVAL;
+  cfg.timestamp_window = DIO_TIMESTAMP_WINDOW;
+  cfg.max_dio_rate = MAX_DIO_RATE;
+  cfg.duplicate_window = DUPLICATE_WINDOW;
+  cfg.auto_blacklist = AUTO_BLACKLIST_ENABLED;
+  cfg.policy = DETECTION_POLICY;
+  cfg.quarantine_threshold = QUARANTINE_THRESHOLD;
+  cfg.quarantine_margin = QUARANTINE_MARGIN;
+  cfg.reset_budget = TRICKLE_RESET_BUDGET;
+  cfg.reset_window = TRICKLE_RESET_WINDOW;
+  cfg.max_dis = MAX_DIS_PER_WINDOW;
+  cfg.max_dao = MAX_DAO_PER_WINDOW;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Load a saved configuration; fields out of range fall back to defaults */
+static int
+config_load(void)
+{
+#if MITIGATION_CONF_WITH_CFS
+  int fd;
+  int ok;
+  unsigned i;
+  uint16_t magic = 0;
+  mitigation_config_t saved;
+
+  fd = cfs_open(CONFIG_FILE, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+  ok = cfs_read(fd, &magic, sizeof(magic)) == sizeof(magic) &&
+       magic == CONFIG_MAGIC &&
+       cfs_read(fd, &saved, sizeof(saved)) == sizeof(saved);
+  cfs_close(fd);
+  if(!ok) {
+    return 0;
+  }
+
+  for(i = 0; i < CONFIG_FIELD_COUNT; i++) {
+    uint16_t v = *(uint16_t *)((uint8_t *)&saved + config_fields[i].offset);
+    if(v >= config_fields[i].min && v <= config_fields[i].max) {
+      *config_value(&config_fields[i]) = v;
+    }
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+#if MITIGATION_CONF_WITH_SHELL
+/*---------------------------------------------------------------------------*/
+/* Set one field by name, rejecting out-of-range values */
+static int
+config_set(const char *name, const char *value)
+{
+  unsigned i;
+  char *end;
+  unsigned long v = strtoul(value, &end, 10);
+
+  if(*value == '\0' || *end != '\0') {
+    return 0;
+  }
+
+  for(i = 0; i < CONFIG_FIELD_COUNT; i++) {
+    if(strcmp(config_fields[i].name, name) == 0) {
+      if(v < config_fields[i].min || v > config_fields[i].max) {
+        return 0;
+      }
+      *config_value(&config_fields[i]) = (uint16_t)v;
+      LOG_INFO("Config: %s = %lu\n", name, v);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Write "name=value ..." into buf */
+static void
+config_format(char *buf, int len)
+{
+  unsigned i;
+  int pos = 0;
+
+  buf[0] = '\0';
+  for(i = 0; i < CONFIG_FIELD_COUNT && pos < len; i++) {
+    pos += snprintf(buf + pos, len - pos, "%s%s=%u", i > 0 ? " " : "",
+                    config_fields[i].name, *config_value(&config_fields[i]));
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Persist the configuration to flash */
+static int
+config_save(void)
+{
+#if MITIGATION_CONF_WITH_CFS
+  int fd;
+  int ok;
+  uint16_t magic = CONFIG_MAGIC;
+
+  cfs_remove(CONFIG_FILE);
+  fd = cfs_open(CONFIG_FILE, CFS_WRITE);
+  if(fd < 0) {
+    return 0;
+  }
+  ok = cfs_write(fd, &magic, sizeof(magic)) == sizeof(magic) &&
+       cfs_write(fd, &cfg, sizeof(cfg)) == sizeof(cfg);
+  cfs_close(fd);
+  return ok;
+#else
+  return 0;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/* Execute a shell command: "", "<name> <value>", "save", "load",
+ * "defaults". The reply goes into buf. */
+static void
+config_command(char *args, char *buf, int len)
+{
+  char *name = args;
+  char *value;
+  const char *status = "ok";
+
+  while(*name == ' ') {
+    name++;
+  }
+  value = strchr(name, ' ');
+  if(value != NULL) {
+    *value++ = '\0';
+    while(*value == ' ') {
+      value++;
+    }
+  }
+
+  if(*name == '\0') {
+    /* Show only */
+  } else if(strcmp(name, "save") == 0) {
+    status = config_save() ? "saved" : "save failed";
+  } else if(strcmp(name, "load") == 0) {
+    status = config_load() ? "loaded" : "load failed";
+  } else if(strcmp(name, "defaults") == 0) {
+    config_defaults();
+  } else if(value == NULL || !config_set(name, value)) {
+    status = "invalid";
+  }
+
+  snprintf(buf, len, "%s: ", status);
+  config_format(buf + strlen(buf), len - strlen(buf));
+}
+#endif /* MITIGATION_CONF_WITH_SHELL */
+
+/*---------------------------------------------------------------------------*/
+/* FNV-1a over the interface identifier, the part neighbors agree on */
+static uint32_t
+digest_hash(const uip_ipaddr_t *addr)
+{
+  int i;
+  uint32_t hash = 2166136261UL;
+
+  for(i = 8; i < 16; i++) {
+    hash ^= addr->u8[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Set (set != 0) or test the Bloom bits of an address */
+static int
+digest_bloom(uint8_t *bloom, const uip_ipaddr_t *addr, int set)
+{
+  int i;
+  uint32_t hash = digest_hash(addr);
+  uint16_t h1 = hash & 0xFFFF;
+  uint16_t h2 = (hash >> 16) | 1;
+
+  for(i = 0; i < DIGEST_BLOOM_HASHES; i++) {
+    uint16_t bit = (uint16_t)(h1 + i * h2) % DIGEST_BLOOM_BITS;
+    if(set) {
+      bloom[bit / 8] |= 1 << (bit % 8);
+    } else if(!(bloom[bit / 8] & (1 << (bit % 8)))) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Recompute the local digest after the blacklist changed */
+static void
+digest_rebuild(void)
+{
+  blacklist_entry_t *entry;
+
+  memset(local_digest.bloom, 0, sizeof(local_digest.bloom));
+  local_digest.entries = 0;
+
+  for(entry = list_head(blacklist); entry != NULL;
+      entry = list_item_next(entry)) {
+    digest_bloom(local_digest.bloom, &entry->addr, 1);
+    local_digest.entries++;
+  }
+
+  local_digest.generation++;
+  if(local_digest.entries == 0) {
+    /* Keep advertising the empty set briefly so neighbors drop ours */
+    digest_empty_repeats = DIGEST_EMPTY_REPEATS;
+  }
+}
+
+#if MITIGATION_CONF_WITH_LL_FILTER
+/*---------------------------------------------------------------------------*/
+/* Derive the link-layer deny set from the blacklist. Only link-local
+ * senders have an IID built from their MAC address; DIOs always come
+ * from one. */
+static void
+ll_deny_rebuild(void)
+{
+  blacklist_entry_t *entry;
+
+  ll_deny_count = 0;
+  for(entry = list_head(blacklist);
+      entry != NULL && ll_deny_count < BLACKLIST_SIZE;
+      entry = list_item_next(entry)) {
+    if(uip_is_addr_linklocal(&entry->addr)) {
+      uip_ds6_set_lladdr_from_iid((uip_lladdr_t *)&ll_deny[ll_deny_count].addr,
+                                  &entry->addr);
+      ll_deny[ll_deny_count].entry = entry;
+      ll_deny_count++;
+    }
+  }
+}
+#endif
+
+/*---------------------------------------------------------------------------*/
+/* Refresh everything derived from the blacklist */
+static void
+blacklist_changed(void)
+{
+  digest_rebuild();
+#if MITIGATION_CONF_WITH_LL_FILTER
+  ll_deny_rebuild();
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/* Check if a node is blacklisted */
+static int
+is_blacklisted(const uip_ipaddr_t *addr)
+{
+  uint32_t current_time = get_timestamp();
+  blacklist_entry_t *entry = blacklist_find(addr);
+  
+  if(entry == NULL) {
+    return 0;
+  }
+  /* Check if temporary blacklist has expired */
+  if(!entry->permanent &&
+     current_time - entry->blacklist_time > cfg.blacklist_duration) {
+    pool_free(POOL_BLACKLIST, entry);
+    state_dirty |= STATE_DIRTY_SUMMARY;
+    LOG_INFO("Blacklist expired for ");
+    LOG_INFO_6ADDR(addr);
+    LOG_INFO_("\n");
+    return 0;
+  }
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Add a node to the blacklist */
+static int
+add_to_blacklist(const uip_ipaddr_t *addr, const char *reason, int permanent)
+{
+  blacklist_entry_t *entry = blacklist_find(addr);
+  
+  /* Check if already blacklisted */
+  if(entry != NULL) {
+    /* Update existing entry */
+    entry->violation_count++;
+    entry->blacklist_time = get_timestamp();
+    if(permanent) {
+      entry->permanent = 1;
+    }
+    state_dirty |= STATE_DIRTY_SUMMARY;
+    LOG_WARN("Updated blacklist entry for ");
+    LOG_WARN_6ADDR(addr);
+    LOG_WARN_(" (violations: %lu)\n", 
+              (unsigned long)entry->violation_count);
+    return 1;
+  }
+  
+  /* Displaces the oldest temporary entry once the table is full */
+  entry = pool_alloc(POOL_BLACKLIST,
+                     permanent ? PRIO_PERMANENT : PRIO_BLACKLIST);
+  if(entry == NULL) {
+    LOG_WARN("Blacklist full of permanent entries, cannot add ");
+    LOG_WARN_6ADDR(addr);
+    LOG_WARN_("\n");
+    return 0;
+  }
+  
+  uip_ipaddr_copy(&entry->addr, addr);
+  entry->blacklist_time = get_timestamp();
+  entry->violation_count = 1;
+  entry->permanent = permanent;
+  strncpy(entry->reason, reason, sizeof(entry->reason) - 1);
+  
+  nodes_blacklisted++;
+  blacklist_changed();
+  state_dirty |= STATE_DIRTY_BLACKLIST;
+#if MITIGATION_CONF_WITH_GROUND_TRUTH
+  if(gt.first_replay != 0 && gt.first_blacklist == 0) {
+    gt.first_blacklist = clock_time();
+  }
+#endif
+  
+  LOG_WARN("⛔ BLACKLISTED: ");
+  LOG_WARN_6ADDR(addr);
+  LOG_WARN_(" | Reason: %s | %s\n", 
+            reason, permanent ? "PERMANENT" : "TEMPORARY");
+  
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Remove a node from the blacklist (manual unblock) */
+static int
+remove_from_blacklist(const uip_ipaddr_t *addr)
+{
+  blacklist_entry_t *entry = blacklist_find(addr);
+  
+  if(entry == NULL) {
+    return 0;
+  }
+  pool_free(POOL_BLACKLIST, entry);
+  state_dirty |= STATE_DIRTY_BLACKLIST;
+  LOG_INFO("Removed from blacklist: ");
+  LOG_INFO_6ADDR(addr);
+  LOG_INFO_("\n");
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Print blacklist table */
+static void
+print_blacklist(void)
+{
+  blacklist_entry_t *entry;
+  int active_count = 0;
+  uint32_t current_time = get_timestamp();
+  
+  LOG_INFO("\n╔════════════════════════════════════════════╗\n");
+  LOG_INFO("║           BLACKLIST TABLE                  ║\n");
+  LOG_INFO("╚════════════════════════════════════════════╝\n");
+  
+  for(entry = list_head(blacklist); entry != NULL;
+      entry = list_item_next(entry)) {
+    uint32_t age = current_time - entry->blacklist_time;
+    
+    active_count++;
+    LOG_INFO("%d. ", active_count);
+    LOG_INFO_6ADDR(&entry->addr);
+    LOG_INFO_("\n");
+    LOG_INFO("   Reason: %s\n", entry->reason);
+    LOG_INFO("   Type: %s\n", 
+             entry->permanent ? "PERMANENT" : "TEMPORARY");
+    LOG_INFO("   Violations: %lu\n", 
+             (unsigned long)entry->violation_count);
+    LOG_INFO("   Age: %lus", (unsigned long)age);
+    
+    if(!entry->permanent) {
+      uint32_t remaining = cfg.blacklist_duration - age;
+      LOG_INFO_(" (expires in %lus)", (unsigned long)remaining);
+    }
+    LOG_INFO_("\n\n");
+  }
+  
+  if(active_count == 0) {
+    LOG_INFO("   (empty)\n");
+  }
+  
+  LOG_INFO("Active entries: %d/%d\n", active_count, BLACKLIST_SIZE);
+  LOG_INFO("════════════════════════════════════════════\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* Whether a DODAG entry is the one RPL has joined */
+static int
+dodag_is_current(const dodag_entry_t *dodag)
+{
+  return curr_instance.dag.state >= DAG_INITIALIZED &&
+         dodag->instance_id == curr_instance.instance_id &&
+         uip_ipaddr_cmp(&dodag->dodag_id, &curr_instance.dag.dag_id);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Find a DODAG entry */
+static dodag_entry_t *
+dodag_find(uint8_t instance_id, const uip_ipaddr_t *dodag_id)
+{
+  dodag_entry_t *dodag;
+
+  for(dodag = list_head(dodags); dodag != NULL;
+      dodag = list_item_next(dodag)) {
+    if(dodag->instance_id == instance_id &&
+       uip_ipaddr_cmp(&dodag->dodag_id, dodag_id)) {
+      return dodag;
+    }
+  }
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Find or create a DODAG entry; the shared overflow entry when the table
+ * holds only DODAGs that outrank a new one */
+static dodag_entry_t *
+dodag_get(uint8_t instance_id, const uip_ipaddr_t *dodag_id)
+{
+  dodag_entry_t *dodag = dodag_find(instance_id, dodag_id);
+
+  if(dodag == NULL) {
+    dodag = pool_alloc(POOL_DODAG, PRIO_BENIGN);
+    if(dodag == NULL) {
+      return &dodag_other;
+    }
+    dodag->instance_id = instance_id;
+    uip_ipaddr_copy(&dodag->dodag_id, dodag_id);
+    LOG_INFO("Tracking DODAG ");
+    LOG_INFO_6ADDR(dodag_id);
+    LOG_INFO_(" (instance %u)\n", instance_id);
+  }
+  return dodag;
+}
+
+/*---------------------------------------------------------------------------*/
+/* The DODAG entry RPL has joined, if it is tracked */
+static dodag_entry_t *
+dodag_current(void)
+{
+  if(curr_instance.dag.state < DAG_INITIALIZED) {
+    return NULL;
+  }
+  return dodag_find(curr_instance.instance_id, &curr_instance.dag.dag_id);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Whether a DIO belongs to the DODAG we are in */
+static int
+dio_for_our_dodag(const dio_info_t *dio)
+{
+  return curr_instance.dag.state >= DAG_INITIALIZED &&
+         dio->instance_id == curr_instance.instance_id &&
+         uip_ipaddr_cmp(&dio->dodag_id, &curr_instance.dag.dag_id);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Find the stats a sender has in one DODAG, or in any of them (NULL) */
+static node_stats_t *
+find_node_stats(const uip_ipaddr_t *addr, const dodag_entry_t *dodag)
+{
+  node_stats_t *stats;
+  
+  for(stats = list_head(node_stats); stats != NULL;
+      stats = list_item_next(stats)) {
+    if(uip_ipaddr_cmp(&stats->sender, addr) &&
+       (dodag == NULL || stats->dodag == dodag)) {
+      return stats;
+    }
+  }
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Find or create the stats a sender has in a DODAG; NULL when the pool
+ * holds only entries that outrank a new sender */
+static node_stats_t *
+get_node_stats(const uip_ipaddr_t *addr, dodag_entry_t *dodag)
+{
+  node_stats_t *stats = find_node_stats(addr, dodag);
+  
+  if(stats == NULL) {
+    /* A sender so far heard only in DIS/DAO keeps its counters */
+    stats = find_node_stats(addr, NULL);
+    if(stats != NULL && stats->dodag == NULL) {
+      stats->dodag = dodag;
+      return stats;
+    }
+    /* A listed sender may only recycle other listed senders' stats */
+    stats = pool_alloc(POOL_STATS, blacklist_find(addr) != NULL ?
+                                   PRIO_LISTED : PRIO_BENIGN);
+    if(stats != NULL) {
+      uip_ipaddr_copy(&stats->sender, addr);
+      stats->dodag = dodag;
+    }
+  }
+  return stats;
+}
+
+#if MITIGATION_CONF_WITH_CFS
+/*---------------------------------------------------------------------------*/
+/* Per-neighbor summary kept in flash: enough to resume counting towards
+ * the blacklist threshold and to keep the learned DIO interval */
+typedef struct {
+  uip_ipaddr_t sender;
+  uip_ipaddr_t dodag_id;
+  uint8_t instance_id;
+  uint32_t violation_count;
+  uint32_t interval_ewma;
+  uint16_t last_rank;
+  uint8_t last_version;
+  uint8_t samples;
+} node_summary_t;
+
+typedef struct {
+  uint16_t magic;
+  uint8_t blacklisted;
+  uint8_t nodes;
+} state_header_t;
+
+/*---------------------------------------------------------------------------*/
+static int
+state_put(int fd, const void *data, int len)
+{
+  if(cfs_write(fd, data, len) != len) {
+    return 0;
+  }
+  state_bytes += len;
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Only stats with a DODAG of their own are worth restoring */
+static int
+state_keyed(const node_stats_t *stats)
+{
+  return stats->dodag != NULL && stats->dodag != &dodag_other;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Write the active blacklist and the neighbor summaries. Blacklist times
+ * are stored as ages, since clock_seconds() restarts at zero on boot. */
+static int
+state_save(void)
+{
+  int fd;
+  int ok;
+  uint32_t now = get_timestamp();
+  state_header_t hdr;
+  blacklist_entry_t entry;
+  blacklist_entry_t *listed;
+  node_summary_t summary;
+  node_stats_t *stats;
+
+  hdr.magic = STATE_MAGIC;
+  hdr.blacklisted = pool_tables[POOL_BLACKLIST].used;
+  hdr.nodes = 0;
+  for(stats = list_head(node_stats); stats != NULL;
+      stats = list_item_next(stats)) {
+    hdr.nodes += state_keyed(stats);
+  }
+
+  cfs_remove(STATE_FILE);
+  fd = cfs_open(STATE_FILE, CFS_WRITE);
+  if(fd < 0) {
+    return 0;
+  }
+  ok = state_put(fd, &hdr, sizeof(hdr));
+  for(listed = list_head(blacklist); ok && listed != NULL;
+      listed = list_item_next(listed)) {
+    entry = *listed;
+    entry.next = NULL;
+    entry.blacklist_time = now - entry.blacklist_time;
+    ok = state_put(fd, &entry, sizeof(entry));
+  }
+  for(stats = list_head(node_stats); ok && stats != NULL;
+      stats = list_item_next(stats)) {
+    if(!state_keyed(stats)) {
+      continue;
+    }
+    uip_ipaddr_copy(&summary.sender, &stats->sender);
+    uip_ipaddr_copy(&summary.dodag_id, &stats->dodag->dodag_id);
+    summary.instance_id = stats->dodag->instance_id;
+    summary.violation_count = stats->violation_count;
+    summary.interval_ewma = stats->interval_ewma;
+    summary.last_rank = stats->last_rank;
+    summary.last_version = stats->last_version;
+    summary.samples = stats->samples;
+    ok = state_put(fd, &summary, sizeof(summary));
+  }
+  cfs_close(fd);
+  return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Restore a checkpoint at boot; blacklistings that ran out while the node
+ * was down, as far as it can tell, are dropped */
+static int
+state_load(void)
+{
+  int fd;
+  int i;
+  int restored = 0;
+  uint32_t now = get_timestamp();
+  state_header_t hdr;
+  blacklist_entry_t entry;
+  blacklist_entry_t *listed;
+  node_summary_t summary;
+  node_stats_t *stats;
+
+  fd = cfs_open(STATE_FILE, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+  if(cfs_read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+     hdr.magic != STATE_MAGIC ||
+     hdr.blacklisted > BLACKLIST_SIZE || hdr.nodes > MAX_NODES) {
+    cfs_close(fd);
+    return 0;
+  }
+
+  for(i = 0; i < hdr.blacklisted; i++) {
+    if(cfs_read(fd, &entry, sizeof(entry)) != sizeof(entry)) {
+      break;
+    }
+    if(!entry.permanent && entry.blacklist_time > cfg.blacklist_duration) {
+      continue;
+    }
+    listed = pool_alloc(POOL_BLACKLIST, PRIO_PERMANENT);
+    if(listed == NULL) {
+      break;
+    }
+    uip_ipaddr_copy(&listed->addr, &entry.addr);
+    listed->blacklist_time = now - entry.blacklist_time;
+    listed->violation_count = entry.violation_count;
+    listed->permanent = entry.permanent;
+    memcpy(listed->reason, entry.reason, sizeof(listed->reason) - 1);
+    restored++;
+  }
+  for(i = 0; i < hdr.nodes; i++) {
+    if(cfs_read(fd, &summary, sizeof(summary)) != sizeof(summary)) {
+      break;
+    }
+    /* last_seen stays 0: the next DIO is treated as the first one heard,
+     * so no interval is learned across the reboot */
+    stats = get_node_stats(&summary.sender,
+                           dodag_get(summary.instance_id, &summary.dodag_id));
+    if(stats == NULL) {
+      break;
+    }
+    stats->violation_count = summary.violation_count;
+    stats->interval_ewma = summary.interval_ewma;
+    stats->last_rank = summary.last_rank;
+    stats->last_version = summary.last_version;
+    stats->samples = summary.samples;
+  }
+  cfs_close(fd);
+
+  blacklist_changed();
+  LOG_INFO("Restored %d blacklist entries and %u neighbor summaries\n",
+           restored, hdr.nodes);
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Batch checkpoints to spare the flash: a blacklist change is written at
+ * most every STATE_MIN_GAP seconds, counter updates every
+ * STATE_SUMMARY_INTERVAL seconds, and nothing when nothing changed */
+static void
+state_checkpoint(void)
+{
+  uint32_t now = get_timestamp();
+  uint32_t gap = (state_dirty & STATE_DIRTY_BLACKLIST) ?
+    STATE_MIN_GAP : STATE_SUMMARY_INTERVAL;
+
+  if(state_dirty == 0 || now - state_last_write < gap) {
+    return;
+  }
+  if(state_save()) {
+    state_writes++;
+  } else {
+    state_write_errors++;
+  }
+  /* A failed write is retried after the same gap */
+  state_last_write = now;
+  state_dirty = 0;
+}
+#endif /* MITIGATION_CONF_WITH_CFS */
+
+/*---------------------------------------------------------------------------*/
+/* Fold one sample into a fixed-point EWMA */
+static uint32_t
+ewma_update(uint32_t avg, uint32_t sample, int first)
+{
+  if(first) {
+    return sample;
+  }
+  if(sample > avg) {
+    return avg + ((sample - avg) >> EWMA_SHIFT);
+  }
+  return avg - ((avg - sample) >> EWMA_SHIFT);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Update baselines with an interval from a DIO that passed detection */
+static void
+adaptive_learn(node_stats_t *stats, uint32_t interval)
+{
+  uint32_t sample = interval << INTERVAL_FRAC_BITS;
+
+  stats->interval_ewma = ewma_update(stats->interval_ewma, sample,
+                                     stats->samples == 0);
+  if(stats->samples < 255) {
+    stats->samples++;
+  }
+  net_interval_ewma = ewma_update(net_interval_ewma, sample,
+                                  net_interval_ewma == 0);
+}
+
+/*---------------------------------------------------------------------------*/
+static uint32_t
+abs_diff(uint32_t a, uint32_t b)
+{
+  return a > b ? a - b : b - a;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Running mean over the first samples, so a young profile is not just its
+ * first reading, then the usual EWMA */
+static uint16_t
+signal_average(uint16_t avg, uint32_t sample, uint8_t n)
+{
+  if(n >= (1 << EWMA_SHIFT)) {
+    return ewma_update(avg, sample, 0);
+  }
+  if(sample > avg) {
+    return avg + (sample - avg) / (n + 1);
+  }
+  return avg - (avg - sample) / (n + 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Fold the radio metadata of a DIO that passed detection into the
+ * sender's signal profile: streaming mean and mean absolute deviation */
+static void
+signal_learn(node_stats_t *stats, const dio_ctx_t *ctx)
+{
+  uint32_t rssi = (uint32_t)(ctx->rssi + SIGNAL_RSSI_OFFSET) << SIGNAL_FRAC_BITS;
+  uint32_t lqi = (uint32_t)ctx->lqi << SIGNAL_FRAC_BITS;
+  uint8_t n = stats->signal_samples;
+
+  if(ctx->rssi == 0) {
+    return;
+  }
+  if(n > 0) {
+    stats->rssi_dev = signal_average(stats->rssi_dev,
+                                     abs_diff(rssi, stats->rssi_ewma), n - 1);
+    stats->lqi_dev = signal_average(stats->lqi_dev,
+                                    abs_diff(lqi, stats->lqi_ewma), n - 1);
+  }
+  stats->rssi_ewma = signal_average(stats->rssi_ewma, rssi, n);
+  stats->lqi_ewma = signal_average(stats->lqi_ewma, lqi, n);
+  if(stats->signal_samples < 255) {
+    stats->signal_samples++;
+  }
+  stats->signal_heard = ctx->now;
+}
+
+/*---------------------------------------------------------------------------*/
+/* DIOs/sec a neighbor may send before it is flagged */
+static uint16_t
+adaptive_rate_limit(void)
+{
+  uint16_t limit;
+
+  if(cfg.policy != POLICY_ADAPTIVE) {
+    return cfg.max_dio_rate;
+  }
+
+  /* Calm Trickle never sends twice a second; churn buys headroom */
+  limit = 1 + churn_score / CHURN_UNIT;
+  return limit < 2 * cfg.max_dio_rate ? limit : 2 * cfg.max_dio_rate;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Seconds within which an identical rank/version repeat is a replay */
+static uint32_t
+adaptive_dup_window(const node_stats_t *stats)
+{
+  uint32_t baseline;
+
+  if(cfg.policy != POLICY_ADAPTIVE) {
+    return cfg.duplicate_window;
+  }
+
+  /* After a repair, neighbors legitimately repeat themselves at Imin */
+  if(churn_score >= CHURN_HIGH) {
+    return 0;
+  }
+
+  /* Repeats at a quarter of the usual interval catch slow replayers */
+  baseline = stats->samples >= ADAPTIVE_MIN_SAMPLES ?
+             stats->interval_ewma : net_interval_ewma;
+  baseline = (baseline >> INTERVAL_FRAC_BITS) / 4;
+  return baseline > cfg.duplicate_window ? baseline : cfg.duplicate_window;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Decay churn and account for local DODAG version changes */
+static void
+adaptive_tick(uint32_t elapsed)
+{
+  while(elapsed-- > 0 && churn_score > 0) {
+    churn_score -= (churn_score >> EWMA_SHIFT) > 0 ?
+                   (churn_score >> EWMA_SHIFT) : 1;
+  }
+
+  if(curr_instance.dag.state >= DAG_INITIALIZED) {
+    if(last_local_version != 0 &&
+       last_local_version != curr_instance.dag.version &&
+       churn_score < CHURN_MAX) {
+      churn_score += CHURN_VERSION_EVENT;
+    }
+    last_local_version = curr_instance.dag.version;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Count a violation and blacklist the sender once it crosses the threshold */
+static void
+count_violation(node_stats_t *stats, uint32_t now, const char *reason)
+{
+  stats->violation_count++;
+  stats->last_violation = now;
+  violations_total++;
+  state_dirty |= STATE_DIRTY_SUMMARY;
+
+  if(cfg.auto_blacklist && 
+     stats->violation_count >= cfg.blacklist_threshold) {
+    add_to_blacklist(&stats->sender, reason, 0);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+record_violation(dio_ctx_t *ctx, const char *reason)
+{
+  count_violation(ctx->stats, ctx->now, reason);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Detector: DIOs that cannot be current for the DODAG we are in */
+static int
+plausibility_on_dio(dio_ctx_t *ctx)
+{
+  const dio_info_t *dio = ctx->dio;
+  rpl_nbr_t *nbr;
+  uint16_t link_metric;
+
+  if(!dio_for_our_dodag(dio)) {
+    return VERDICT_ACCEPT;
+  }
+
+  /* An older version is what a lagging neighbor or a replayer sends; both
+   * are harmless to drop, so no violation is counted */
+  if(RPL_LOLLIPOP_GREATER_THAN(curr_instance.dag.version, dio->version)) {
+    plaus_stale_version++;
+    return VERDICT_BLOCK;
+  }
+
+  if(dio->rank == RPL_INFINITE_RANK) {
+    return VERDICT_ACCEPT;
+  }
+
+  /* Only the root (whose IID is in the DODAG ID) may claim ROOT_RANK */
+  if(dio->rank < ROOT_RANK ||
+     (dio->rank == ROOT_RANK &&
+      memcmp(&dio->sender.u8[8], &dio->dodag_id.u8[8], 8) != 0)) {
+    plaus_bad_rank++;
+    LOG_WARN("IMPOSSIBLE RANK from ");
+    LOG_WARN_6ADDR(&dio->sender);
+    LOG_WARN_(" (rank: %u, root rank: %u) - REPLAY!\n", dio->rank, ROOT_RANK);
+    record_violation(ctx, "Impossible rank");
+    return VERDICT_BLOCK;
+  }
+
+  /* A big jump in one step that would also make the sender our best path */
+  if(!ctx->first && ctx->stats->last_version == dio->version &&
+     ctx->stats->last_rank > dio->rank &&
+     ctx->stats->last_rank - dio->rank > RANK_JUMP_HOPS * ROOT_RANK) {
+    nbr = rpl_neighbor_get_from_ipaddr((uip_ipaddr_t *)&dio->sender);
+    link_metric = nbr != NULL ? rpl_neighbor_get_link_metric(nbr) : ROOT_RANK;
+    if((uint32_t)dio->rank + link_metric < curr_instance.dag.rank) {
+      plaus_rank_jump++;
+      LOG_WARN("RANK JUMP from ");
+      LOG_WARN_6ADDR(&dio->sender);
+      LOG_WARN_(" (%u -> %u, same version) - REPLAY!\n",
+                ctx->stats->last_rank, dio->rank);
+      record_violation(ctx, "Rank jump");
+      return VERDICT_BLOCK;
+    }
+  }
+
+  return VERDICT_ACCEPT;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+plausibility_report(void)
+{
+  LOG_INFO("  stale version=%lu impossible rank=%lu rank jump=%lu\n",
+           (unsigned long)plaus_stale_version,
+           (unsigned long)plaus_bad_rank,
+           (unsigned long)plaus_rank_jump);
+}
+
+static const dio_detector_t plausibility_detector = {
+  "plausibility", NULL, plausibility_on_dio, NULL, plausibility_report
+};
+
+/*---------------------------------------------------------------------------*/
+/* Detector: drop everything from blacklisted senders */
+static int
+blacklist_on_dio(dio_ctx_t *ctx)
+{
+  if(is_blacklisted(&ctx->dio->sender)) {
+    dio_blocked_blacklist++;
+    LOG_WARN("🚫 BLOCKED (blacklisted): ");
+    LOG_WARN_6ADDR(&ctx->dio->sender);
+    LOG_WARN_("\n");
+    return VERDICT_BLOCK;
+  }
+  return VERDICT_ACCEPT;
+}
+
+static const dio_detector_t blacklist_detector = {
+  "blacklist", init_blacklist, blacklist_on_dio, NULL, NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* Detector: a parent advertising a rank at or above ours may be losing its
+ * own path, which RPL has to hear about. It is only a replay if the
+ * fingerprint cache shows this very DIO superseded by a better rank in the
+ * same version, i.e. the parent's older, worse DIO coming back. */
+static int
+rank_on_dio(dio_ctx_t *ctx)
+{
+  const dio_info_t *dio = ctx->dio;
+  uip_ipaddr_t *parent;
+  uint32_t fingerprint;
+  dio_cache_entry_t *entry;
+  dio_cache_entry_t *match = NULL;
+  dio_cache_entry_t *better = NULL;
+
+  /* Our rank and parent only mean something within our own DODAG */
+  if(!dio_for_our_dodag(dio) ||
+     dio->rank == RPL_INFINITE_RANK ||
+     dio->rank < curr_instance.dag.rank) {
+    return VERDICT_ACCEPT;
+  }
+
+  parent = rpl_neighbor_get_ipaddr(curr_instance.dag.preferred_parent);
+  if(parent == NULL || !uip_ipaddr_cmp(parent, &dio->sender)) {
+    return VERDICT_ACCEPT;
+  }
+
+  fingerprint = dio_fingerprint(dio);
+  for(entry = list_head(dio_cache); entry != NULL;
+      entry = list_item_next(entry)) {
+    if(!uip_ipaddr_cmp(&entry->sender, &dio->sender) ||
+       entry->version != dio->version) {
+      continue;
+    }
+    if(entry->fingerprint == fingerprint) {
+      match = entry;
+    } else if(entry->rank < dio->rank &&
+              (better == NULL || entry->timestamp > better->timestamp)) {
+      better = entry;
+    }
+  }
+  if(match == NULL || better == NULL ||
+     match->timestamp >= better->timestamp) {
+    rank_passed++;
+    return VERDICT_ACCEPT;
+  }
+
+  LOG_WARN("RANK INCONSISTENT DIO from parent ");
+  LOG_WARN_6ADDR(&dio->sender);
+  LOG_WARN_(" (rank: %u >= own %u, rank %u heard since) - REPLAY!\n",
+            dio->rank, curr_instance.dag.rank, better->rank);
+  record_violation(ctx, "Rank inconsistency");
+  return VERDICT_REPLAY;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+rank_report(void)
+{
+  LOG_INFO("  parent rank >= own passed to RPL=%lu\n",
+           (unsigned long)rank_passed);
+}
+
+static const dio_detector_t rank_detector = {
+  "rank-consistency", NULL, rank_on_dio, NULL, rank_report
+};
+
+/*---------------------------------------------------------------------------*/
+/* Imin/2, the shortest gap Trickle allows between two DIOs of a node;
+ * 0 while no Trickle parameters are known */
+static clock_time_t
+trickle_min_gap(void)
+{
+  if(curr_instance.dio_intmin == 0) {
+    return 0;
+  }
+  return ((clock_time_t)1 << curr_instance.dio_intmin) * CLOCK_SECOND / 2000;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Detector: Trickle never lets a node transmit twice within Imin/2.
+ * Unicast DIOs are sent outside the timer and are not held to it. */
+static int
+trickle_on_dio(dio_ctx_t *ctx)
+{
+  clock_time_t min_gap = trickle_min_gap();
+  clock_time_t gap;
+
+  if(ctx->first || ctx->unicast || min_gap == 0) {
+    return VERDICT_ACCEPT;
+  }
+
+  gap = ctx->arrival - ctx->stats->last_arrival;
+  if(gap >= min_gap) {
+    return VERDICT_ACCEPT;
+  }
+
+  LOG_WARN("TRICKLE VIOLATION from ");
+  LOG_WARN_6ADDR(&ctx->dio->sender);
+  LOG_WARN_(" (%lu ms apart, Imin/2 = %lu ms) - REPLAY!\n",
+            (unsigned long)(gap * 1000 / CLOCK_SECOND),
+            (unsigned long)(min_gap * 1000 / CLOCK_SECOND));
+  record_violation(ctx, "Trickle violation");
+  return VERDICT_REPLAY;
+}
+
+static const dio_detector_t trickle_detector = {
+  "trickle-model", NULL, trickle_on_dio, NULL, NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* Detector: more DIOs per second than the policy allows */
+static int
+rate_on_dio(dio_ctx_t *ctx)
+{
+  node_stats_t *stats = ctx->stats;
+
+  /* Reset counter every second */
+  if(stats->last_count_reset != ctx->now) {
+    stats->dio_count_per_sec = 0;
+    stats->last_count_reset = ctx->now;
+  }
+  
+  stats->dio_count_per_sec++;
+  
+  /* Detect high-frequency DIOs (replay attack signature) */
+  if(stats->dio_count_per_sec > adaptive_rate_limit()) {
+    LOG_WARN("HIGH FREQUENCY DIOs from ");
+    LOG_WARN_6ADDR(&ctx->dio->sender);
+    LOG_WARN_(" (%u DIOs/sec) - REPLAY ATTACK!\n", stats->dio_count_per_sec);
+    dio_suspicious++;
+    record_violation(ctx, "High frequency attack");
+    return VERDICT_REPLAY;
+  }
+  return VERDICT_ACCEPT;
+}
+
+static const dio_detector_t rate_detector = {
+  "high-frequency", NULL, rate_on_dio, NULL, NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* Detector: same rank and version again within the duplicate window.
+ * A unicast DIO repeats the sender's state on request, so it is exempt. */
+static int
+duplicate_on_dio(dio_ctx_t *ctx)
+{
+  node_stats_t *stats = ctx->stats;
+
+  if(!ctx->first && !ctx->unicast &&
+     stats->last_rank == ctx->dio->rank && 
+     stats->last_version == ctx->dio->version &&
+     ctx->time_diff < adaptive_dup_window(stats)) {
+    LOG_WARN("DUPLICATE DIO from ");
+    LOG_WARN_6ADDR(&ctx->dio->sender);
+    LOG_WARN_(" (rank: %u, ver: %u, %lus ago) - REPLAY!\n", 
+             ctx->dio->rank, ctx->dio->version,
+             (unsigned long)ctx->time_diff);
+    record_violation(ctx, "Duplicate replay");
+    return VERDICT_REPLAY;
+  }
+  return VERDICT_ACCEPT;
+}
+
+static const dio_detector_t duplicate_detector = {
+  "duplicate", NULL, duplicate_on_dio, NULL, NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* Whether a sample lies outside mean +- max(K deviations, floor) */
+static int
+signal_outlier(uint32_t sample, uint16_t avg, uint16_t dev, uint16_t floor)
+{
+  uint32_t tol = (uint32_t)dev * SIGNAL_DEV_K;
+
+  if(tol < ((uint32_t)floor << SIGNAL_FRAC_BITS)) {
+    tol = (uint32_t)floor << SIGNAL_FRAC_BITS;
+  }
+  return abs_diff(sample, avg) > tol;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Detector: a relayed DIO carries the sender's addresses but arrives with
+ * the signal of the relay's position */
+static int
+signal_on_dio(dio_ctx_t *ctx)
+{
+  node_stats_t *stats = ctx->stats;
+  int rssi_off;
+  int lqi_off;
+
+  if(ctx->rssi == 0) {
+    return VERDICT_ACCEPT;
+  }
+  if(stats->signal_samples > 0 &&
+     ctx->now - stats->signal_heard > SIGNAL_STALE) {
+    /* Long silence: the sender may have moved, start over */
+    stats->signal_samples = 0;
+    signal_relearned++;
+  }
+  if(stats->signal_samples < SIGNAL_MIN_SAMPLES) {
+    return VERDICT_ACCEPT;
+  }
+
+  signal_checked++;
+  rssi_off = signal_outlier((uint32_t)(ctx->rssi + SIGNAL_RSSI_OFFSET) <<
+                            SIGNAL_FRAC_BITS, stats->rssi_ewma,
+                            stats->rssi_dev, SIGNAL_RSSI_FLOOR);
+  lqi_off = signal_outlier((uint32_t)ctx->lqi << SIGNAL_FRAC_BITS,
+                           stats->lqi_ewma, stats->lqi_dev, SIGNAL_LQI_FLOOR);
+  if(!rssi_off && !lqi_off) {
+    return VERDICT_ACCEPT;
+  }
+
+  signal_rssi_hits += rssi_off;
+  signal_lqi_hits += lqi_off;
+  LOG_WARN("SIGNAL MISMATCH from ");
+  LOG_WARN_6ADDR(&ctx->dio->sender);
+  LOG_WARN_(" (rssi %d dBm lqi %u, profile %d/%u dBm lqi %u) - RELAYED!\n",
+            ctx->rssi, ctx->lqi,
+            (stats->rssi_ewma >> SIGNAL_FRAC_BITS) - SIGNAL_RSSI_OFFSET,
+            stats->rssi_dev >> SIGNAL_FRAC_BITS,
+            stats->lqi_ewma >> SIGNAL_FRAC_BITS);
+  record_violation(ctx, "Signal mismatch");
+  return VERDICT_REPLAY;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+signal_report(void)
+{
+  LOG_INFO("  profiled=%lu rssi mismatch=%lu lqi mismatch=%lu relearned=%lu\n",
+           (unsigned long)signal_checked, (unsigned long)signal_rssi_hits,
+           (unsigned long)signal_lqi_hits, (unsigned long)signal_relearned);
+}
+
+static const dio_detector_t signal_detector = {
+  "signal-profile", NULL, signal_on_dio, NULL, signal_report
+};
+
+/*---------------------------------------------------------------------------*/
+/* FNV-1a over the DIO base object and options */
+static uint32_t
+dio_fingerprint(const dio_info_t *dio)
+{
+  uint16_t i;
+  uint32_t hash = 2166136261UL;
+  const uint8_t *body = dio->options - DIO_BASE_LEN;
+
+  for(i = 0; i < DIO_BASE_LEN + dio->options_len; i++) {
+    hash ^= body[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+fingerprint_init(void)
+{
+  dio_cache_entry_t *entry;
+
+  while((entry = list_head(dio_cache)) != NULL) {
+    pool_free(POOL_CACHE, entry);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Detector: content the sender has already moved away from reappears.
+ * Honest Trickle repeats its latest DIO; a replayer repeats an old one. */
+static int
+fingerprint_on_dio(dio_ctx_t *ctx)
+{
+  uint32_t fingerprint = dio_fingerprint(ctx->dio);
+  dio_cache_entry_t *entry;
+  dio_cache_entry_t *match = NULL;
+  uint32_t newest = 0;
+
+  for(entry = list_head(dio_cache); entry != NULL;
+      entry = list_item_next(entry)) {
+    if(!uip_ipaddr_cmp(&entry->sender, &ctx->dio->sender)) {
+      continue;
+    }
+    if(entry->fingerprint == fingerprint) {
+      match = entry;
+    }
+    if(entry->timestamp > newest) {
+      newest = entry->timestamp;
+    }
+  }
+
+  if(match == NULL) {
+    /* Only ever displaces the oldest fingerprint */
+    match = pool_alloc(POOL_CACHE, PRIO_CACHE);
+    if(match == NULL) {
+      return VERDICT_ACCEPT;
+    }
+    uip_ipaddr_copy(&match->sender, &ctx->dio->sender);
+    match->fingerprint = fingerprint;
+    match->rank = ctx->dio->rank;
+    match->version = ctx->dio->version;
+    match->dio_count = 0;
+  } else if(match->timestamp < newest &&
+            ctx->now - match->timestamp < cfg.timestamp_window) {
+    /* Leave the stale entry untouched so it keeps matching */
+    LOG_WARN("STALE DIO from ");
+    LOG_WARN_6ADDR(&ctx->dio->sender);
+    LOG_WARN_(" (rank: %u, ver: %u, superseded %lus ago) - REPLAY!\n",
+              ctx->dio->rank, ctx->dio->version,
+              (unsigned long)(ctx->now - newest));
+    record_violation(ctx, "Stale DIO replay");
+    return VERDICT_REPLAY;
+  }
+
+  match->timestamp = ctx->now;
+  if(match->dio_count < 255) {
+    match->dio_count++;
+  }
+  return VERDICT_ACCEPT;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Forget fingerprints older than the timestamp window */
+static void
+fingerprint_on_tick(uint32_t elapsed)
+{
+  dio_cache_entry_t *entry;
+  dio_cache_entry_t *next;
+  uint32_t current_time = get_timestamp();
+
+  for(entry = list_head(dio_cache); entry != NULL; entry = next) {
+    next = list_item_next(entry);
+    if(current_time - entry->timestamp > cfg.timestamp_window) {
+      pool_free(POOL_CACHE, entry);
+    }
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+fingerprint_report(void)
+{
+  LOG_INFO("Cache usage:         %u/%d\n",
+           pool_tables[POOL_CACHE].used, DIO_CACHE_SIZE);
+}
+
+static const dio_detector_t fingerprint_detector = {
+  "fingerprint", fingerprint_init, fingerprint_on_dio,
+  fingerprint_on_tick, fingerprint_report
+};
+
+/*---------------------------------------------------------------------------*/
+/* Detector chain, cheapest first. A BLOCK verdict ends the chain. */
+static const dio_detector_t *const detectors[] = {
+  &plausibility_detector,
+  &blacklist_detector,
+  &rank_detector,
+  &trickle_detector,
+  &rate_detector,
+  &duplicate_detector,
+  &signal_detector,
+  &fingerprint_detector,
+};
+
+#define DETECTOR_COUNT (sizeof(detectors) / sizeof(detectors[0]))
+
+static detector_cost_t detector_costs[DETECTOR_COUNT];
+/* Detectors, by bit, that flagged the DIO last run through the chain */
+static uint16_t chain_hits;
+
+/*---------------------------------------------------------------------------*/
+static void
+init_detectors(void)
+{
+  unsigned i;
+
+  memset(detector_costs, 0, sizeof(detector_costs));
+  memset(bursts, 0, sizeof(bursts));
+  for(i = 0; i < DETECTOR_COUNT; i++) {
+    if(detectors[i]->init != NULL) {
+      detectors[i]->init();
+    }
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Run a DIO through the detector chain */
+static int
+detect_replay_behavior(const dio_info_t *dio)
+{
+  unsigned i;
+  dio_ctx_t ctx;
+  node_stats_t *stats = get_node_stats(&dio->sender, dio->dodag);
+  static node_stats_t untracked;
+  int verdict = VERDICT_ACCEPT;
+  
+  if(stats == NULL) {
+    /* No room: judge the DIO as the sender's first, keep no history */
+    memset(&untracked, 0, sizeof(untracked));
+    uip_ipaddr_copy(&untracked.sender, &dio->sender);
+    untracked.dodag = dio->dodag;
+    stats = &untracked;
+  }
+  /* Allocations further down the chain must not evict this entry */
+  pool_pinned = stats;
+  
+  ctx.dio = dio;
+  ctx.stats = stats;
+  ctx.now = get_timestamp();
+  ctx.arrival = clock_time();
+  ctx.first = stats->last_seen == 0;
+  ctx.unicast = !uip_is_addr_mcast(&UIP_IP_BUF->destipaddr);
+  ctx.time_diff = ctx.first ? 0 : ctx.now - stats->last_seen;
+  /* Still the received frame: 6LoWPAN hands packets up synchronously */
+  ctx.rssi = (int16_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+  ctx.lqi = packetbuf_attr(PACKETBUF_ATTR_LINK_QUALITY);
+  
+  dio_received++;
+  chain_hits = 0;
+  
+  for(i = 0; i < DETECTOR_COUNT; i++) {
+    rtimer_clock_t start = RTIMER_NOW();
+    int v = detectors[i]->on_dio(&ctx);
+    
+    detector_costs[i].ticks += RTIMER_NOW() - start;
+    detector_costs[i].calls++;
+    if(v != VERDICT_ACCEPT) {
+      detector_costs[i].hits++;
+      chain_hits |= 1 << i;
+    }
+    if(v > verdict) {
+      verdict = v;
+    }
+    if(verdict == VERDICT_BLOCK) {
+      /* Rejected DIOs must not touch the sender's history */
+      pool_pinned = NULL;
+      return verdict;
+    }
+  }
+  pool_pinned = NULL;
+  
+  if(!ctx.first) {
+    if((stats->last_rank != dio->rank || stats->last_version != dio->version) &&
+       churn_score < CHURN_MAX) {
+      churn_score += stats->last_version != dio->version ?
+                     CHURN_VERSION_EVENT : CHURN_RANK_EVENT;
+    }
+    
+    /* Only honest, Trickle-paced traffic may train the baselines */
+    if(verdict == VERDICT_ACCEPT && !ctx.unicast) {
+      adaptive_learn(stats, ctx.time_diff);
+    }
+  }
+  if(verdict == VERDICT_ACCEPT) {
+    signal_learn(stats, &ctx);
+  }
+  
+  /* Update stats; the Trickle and duplicate checks time multicast DIOs
+   * against each other only */
+  if(!ctx.unicast) {
+    stats->last_seen = ctx.now;
+    stats->last_arrival = ctx.arrival;
+  }
+  stats->last_rank = dio->rank;
+  stats->last_version = dio->version;
+  
+  if(verdict == VERDICT_REPLAY) {
+    dio_replayed++;
+  } else {
+    dio_accepted++;
+  }
+  
+  return verdict;
+}
+
+/*---------------------------------------------------------------------------*/
+/* End a burst record, summing up what was coalesced in one line */
+static void
+burst_close(burst_entry_t *burst)
+{
+  if(burst->coalesced > 0) {
+    burst_records++;
+    LOG_WARN("BURST from ");
+    LOG_WARN_6ADDR(&burst->sender);
+    LOG_WARN_(" - %u copies of one DIO, %u judged without the detectors\n",
+              burst->copies, burst->coalesced);
+  }
+  memset(burst, 0, sizeof(*burst));
+}
+
+/*---------------------------------------------------------------------------*/
+/* Burst record of a DIO: the one it repeats within Imin/2, or a fresh one
+ * in the oldest slot. NULL while the Trickle parameters are unknown. */
+static burst_entry_t *
+burst_get(const dio_info_t *dio, uint32_t fingerprint, clock_time_t now)
+{
+  int i;
+  burst_entry_t *burst;
+  burst_entry_t *oldest = &bursts[0];
+  clock_time_t window = trickle_min_gap();
+
+  if(window == 0) {
+    return NULL;
+  }
+  for(i = 0; i < BURST_SLOTS; i++) {
+    burst = &bursts[i];
+    if(burst->copies > 0 && now - burst->first < window &&
+       burst->fingerprint == fingerprint &&
+       uip_ipaddr_cmp(&burst->sender, &dio->sender)) {
+      if(burst->copies < 0xFFFF) {
+        burst->copies++;
+      }
+      return burst;
+    }
+    if(oldest->copies > 0 &&
+       (burst->copies == 0 || now - burst->first > now - oldest->first)) {
+      oldest = burst;
+    }
+  }
+
+  burst_close(oldest);
+  uip_ipaddr_copy(&oldest->sender, &dio->sender);
+  oldest->fingerprint = fingerprint;
+  oldest->first = now;
+  oldest->copies = 1;
+  return oldest;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Judge a later copy of a burst the way its first repeat was judged:
+ * Trickle never repeats a DIO within Imin/2, so every such copy is a
+ * replay. The blacklist and the rate limit depend on what came before
+ * the copy and are checked again; the other detectors are credited with
+ * the hits and violations they had on the first repeat. */
+static int
+burst_coalesce(const dio_info_t *dio, burst_entry_t *burst)
+{
+  node_stats_t *stats = find_node_stats(&dio->sender, dio->dodag);
+  dio_ctx_t ctx;
+  int verdict = burst->verdict;
+  uint8_t i;
+
+  burst->coalesced++;
+  burst_coalesced++;
+  dio_received++;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.dio = dio;
+  ctx.stats = stats;
+  ctx.now = get_timestamp();
+  for(i = 0; i < DETECTOR_COUNT; i++) {
+    if(detectors[i] == &blacklist_detector) {
+      if(is_blacklisted(&dio->sender)) {
+        detector_costs[i].hits++;
+        dio_blocked_blacklist++;
+        return VERDICT_BLOCK;
+      }
+    } else if(detectors[i] == &rate_detector) {
+      if(stats != NULL && rate_on_dio(&ctx) != VERDICT_ACCEPT) {
+        detector_costs[i].hits++;
+      }
+    } else if(burst->hits & (1 << i)) {
+      detector_costs[i].hits++;
+      if(burst->verdict == VERDICT_BLOCK) {
+        return VERDICT_BLOCK;
+      }
+    }
+  }
+
+  for(i = 0; stats != NULL && i < burst->violations; i++) {
+    count_violation(stats, ctx.now, "Burst replay");
+  }
+  if(stats != NULL && uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
+    /* The next copy is timed against this one, as the chain would */
+    stats->last_seen = ctx.now;
+    stats->last_arrival = clock_time();
+  }
+  if(verdict == VERDICT_REPLAY) {
+    dio_replayed++;
+  }
+  return verdict;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Close the bursts whose window has passed */
+static void
+burst_expire(void)
+{
+  int i;
+  clock_time_t now = clock_time();
+  clock_time_t window = trickle_min_gap();
+
+  for(i = 0; i < BURST_SLOTS; i++) {
+    if(bursts[i].copies > 0 && now - bursts[i].first >= window) {
+      burst_close(&bursts[i]);
+    }
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Periodic housekeeping for the policy and every detector */
+static void
+detectors_tick(uint32_t elapsed)
+{
+  unsigned i;
+
+  adaptive_tick(elapsed);
+  burst_expire();
+  for(i = 0; i < DETECTOR_COUNT; i++) {
+    if(detectors[i]->on_tick != NULL) {
+      detectors[i]->on_tick(elapsed);
+    }
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Per-detector hit counts and CPU cost per DIO */
+static void
+print_detector_costs(void)
+{
+  unsigned i;
+
+  LOG_INFO("\n--- Detector Chain ---\n");
+  for(i = 0; i < DETECTOR_COUNT; i++) {
+    const detector_cost_t *cost = &detector_costs[i];
+    unsigned long avg_us = cost->calls > 0 ?
+      (unsigned long)((uint64_t)cost->ticks * 1000000 /
+                      RTIMER_SECOND / cost->calls) : 0;
+
+    LOG_INFO("%-17s calls=%lu hits=%lu avg=%lu us/DIO\n",
+             detectors[i]->name, (unsigned long)cost->calls,
+             (unsigned long)cost->hits, avg_us);
+    if(detectors[i]->report != NULL) {
+      detectors[i]->report();
+    }
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* RPL control message code of the packet in uip_buf, or -1 for anything
+ * else. Extension headers are skipped: non-storing DAOs carry the RPL
+ * hop-by-hop option. body is set to the message past the ICMPv6 header. */
+static int
+rpl_message_code(uint8_t **body)
+{
+  uint8_t proto;
+  struct uip_icmp_hdr *icmp = (struct uip_icmp_hdr *)
+    uipbuf_get_last_header(uip_buf, uip_len, &proto);
+
+  if(icmp == NULL || proto != UIP_PROTO_ICMP6 ||
+     (uint8_t *)icmp + UIP_ICMPH_LEN > uip_buf + uip_len ||
+     icmp->type != ICMP6_RPL) {
+    return -1;
+  }
+  *body = (uint8_t *)icmp + UIP_ICMPH_LEN;
+  return icmp->icode;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Update the IPv6 payload length and ICMPv6 checksum after an edit */
+static void
+fix_icmp6_length(uint16_t new_len)
+{
+  struct uip_icmp_hdr *icmp = (struct uip_icmp_hdr *)&uip_buf[UIP_IPH_LEN];
+  uint16_t saved_ext_len = uip_ext_len;
+  uint16_t payload_len = new_len - UIP_IPH_LEN;
+
+  uipbuf_set_len(new_len);
+  UIP_IP_BUF->len[0] = payload_len >> 8;
+  UIP_IP_BUF->len[1] = payload_len & 0xFF;
+
+  /* RPL messages leave the stack without extension headers */
+  uip_ext_len = 0;
+  icmp->icmpchksum = 0;
+  icmp->icmpchksum = ~uip_icmp6chksum();
+  uip_ext_len = saved_ext_len;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Parse the DIO base object at base, in uip_buf */
+static int
+parse_dio(dio_info_t *dio, uint8_t *base)
+{
+  uint16_t total_len = UIP_IPH_LEN +
+    ((UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
+
+  if(total_len > uip_len || base + DIO_BASE_LEN > uip_buf + total_len) {
+    return 0;
+  }
+
+  uip_ipaddr_copy(&dio->sender, &UIP_IP_BUF->srcipaddr);
+  dio->instance_id = base[0];
+  dio->version = base[1];
+  dio->rank = (base[2] << 8) | base[3];
+  memcpy(&dio->dodag_id, &base[8], sizeof(uip_ipaddr_t));
+  dio->options = &base[DIO_BASE_LEN];
+  dio->options_len = uip_buf + total_len - dio->options;
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Append the local blacklist digest to an outgoing DIO */
+static void
+digest_append(void)
+{
+  uint8_t *opt = &uip_buf[uip_len];
+
+  if(uip_len + 2 + DIGEST_OPTION_LEN > UIP_BUFSIZE) {
+    return;
+  }
+
+  opt[0] = RPL_OPTION_BLACKLIST_DIGEST;
+  opt[1] = DIGEST_OPTION_LEN;
+  opt[2] = local_digest.generation;
+  opt[3] = local_digest.entries;
+  memcpy(&opt[4], local_digest.bloom, sizeof(local_digest.bloom));
+  fix_icmp6_length(uip_len + 2 + DIGEST_OPTION_LEN);
+
+  digest_dios_tagged++;
+  digest_bytes_added += 2 + DIGEST_OPTION_LEN;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Store a neighbor's digest if it is newer than the one we hold */
+static void
+digest_merge(const uip_ipaddr_t *origin, const uint8_t *opt)
+{
+  int i;
+  remote_digest_t *slot = NULL;
+  remote_digest_t *oldest = &remote_digests[0];
+  uint32_t now = get_timestamp();
+  uint16_t bits = 0;
+  uint8_t byte;
+
+  /* Each entry sets at most DIGEST_BLOOM_HASHES bits; a fuller filter
+   * would match every sender */
+  for(i = 0; i < DIGEST_BLOOM_BITS / 8; i++) {
+    for(byte = opt[2 + i]; byte != 0; byte &= byte - 1) {
+      bits++;
+    }
+  }
+  if(opt[1] > BLACKLIST_SIZE || bits > opt[1] * DIGEST_BLOOM_HASHES ||
+     (opt[1] > 0) != (bits > 0)) {
+    digest_rejected++;
+    return;
+  }
+
+  for(i = 0; i < DIGEST_NEIGHBORS; i++) {
+    if(remote_digests[i].valid &&
+       uip_ipaddr_cmp(&remote_digests[i].origin, origin)) {
+      slot = &remote_digests[i];
+      break;
+    }
+    if(remote_digests[i].last_heard < oldest->last_heard) {
+      oldest = &remote_digests[i];
+    }
+  }
+
+  if(slot != NULL) {
+    /* Generation counters wrap; only strictly newer digests replace ours.
+     * After DIGEST_RESYNC without one, any generation is taken: the origin
+     * may have rebooted with a different counter. */
+    if((int8_t)(opt[0] - slot->digest.generation) <= 0 &&
+       now - slot->last_heard < DIGEST_RESYNC) {
+      return;
+    }
+  } else {
+    slot = oldest;
+    uip_ipaddr_copy(&slot->origin, origin);
+    slot->valid = 1;
+  }
+  slot->last_heard = now;
+
+  slot->digest.generation = opt[0];
+  slot->digest.entries = opt[1];
+  memcpy(slot->digest.bloom, &opt[2], sizeof(slot->digest.bloom));
+  digest_merged++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Number of neighbors other than the sender whose digests list it */
+static int
+digest_remote_lookup(const uip_ipaddr_t *sender)
+{
+  int i;
+  int origins = 0;
+  uint32_t current_time = get_timestamp();
+
+  for(i = 0; i < DIGEST_NEIGHBORS; i++) {
+    if(!remote_digests[i].valid) {
+      continue;
+    }
+    if(current_time - remote_digests[i].last_heard > cfg.blacklist_duration) {
+      remote_digests[i].valid = 0;
+      continue;
+    }
+    if(remote_digests[i].digest.entries > 0 &&
+       !uip_ipaddr_cmp(&remote_digests[i].origin, sender) &&
+       digest_bloom(remote_digests[i].digest.bloom, sender, 0)) {
+      origins++;
+    }
+  }
+  return origins;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Take a piggybacked digest out of the DIO into opt, and apply remote
+ * knowledge to the sender. Returns 1 if the DIO carried a digest; it is
+ * only merged once the detectors have accepted the DIO. */
+static int
+digest_input(dio_info_t *dio, uint8_t *opt)
+{
+  uint16_t i = 0;
+  int found = 0;
+
+  while(i < dio->options_len) {
+    uint8_t type = dio->options[i];
+    uint8_t len;
+
+    if(type == RPL_OPTION_PAD1) {
+      i++;
+      continue;
+    }
+    if(i + 1 >= dio->options_len) {
+      break;
+    }
+    len = dio->options[i + 1];
+    if(i + 2 + len > dio->options_len) {
+      break;
+    }
+
+    if(type == RPL_OPTION_BLACKLIST_DIGEST && len == DIGEST_OPTION_LEN) {
+      digest_received++;
+      memcpy(opt, &dio->options[i + 2], DIGEST_OPTION_LEN);
+      found = 1;
+
+      /* We append the digest last; strip it so RPL sees a plain DIO */
+      if(i + 2 + len == dio->options_len) {
+        fix_icmp6_length(uip_len - (2 + len));
+        dio->options_len = i;
+      }
+      break;
+    }
+    i += 2 + len;
+  }
+
+  /* Hits from several neighbors leave the sender one local violation from
+   * the blacklist. Bloom filters have false positives, and one neighbor
+   * may lie, so this never blacklists on its own. */
+  if(!is_blacklisted(&dio->sender) &&
+     digest_remote_lookup(&dio->sender) >= DIGEST_MIN_ORIGINS) {
+    node_stats_t *stats = get_node_stats(&dio->sender, dio->dodag);
+
+    if(stats != NULL &&
+       stats->violation_count + 1 < cfg.blacklist_threshold) {
+      stats->violation_count = cfg.blacklist_threshold - 1;
+      stats->last_violation = get_timestamp();
+      digest_remote_hits++;
+      LOG_WARN("Remote digest lists ");
+      LOG_WARN_6ADDR(&dio->sender);
+      LOG_WARN_(" - one violation from blacklist\n");
+    }
+  }
+  return found;
+}
+
+#if MITIGATION_CONF_WITH_GROUND_TRUTH
+/*---------------------------------------------------------------------------*/
+/* Whether the DIO in uip_buf carries the replay label */
+static int
+gt_is_replay(void)
+{
+  uint32_t label = ((uint32_t)(uip_buf[1] & 0x0F) << 16) |
+                   (uip_buf[2] << 8) | uip_buf[3];
+
+  return label == GROUND_TRUTH_FLOW_LABEL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Score one verdict and, on the first caught replay since the sender's
+ * stats entry was created, record the detection latency */
+static void
+gt_record(const dio_info_t *dio, int verdict)
+{
+  node_stats_t *stats;
+  clock_time_t now = clock_time();
+  uint32_t ms;
+  int bucket;
+
+  if(!gt_is_replay()) {
+    if(verdict == VERDICT_ACCEPT) {
+      gt.tn++;
+    } else {
+      gt.fp++;
+    }
+    return;
+  }
+
+  stats = find_node_stats(&dio->sender, dio->dodag);
+  if(gt.first_replay == 0) {
+    gt.first_replay = now;
+  }
+  if(stats != NULL && stats->gt_first_replay == 0) {
+    stats->gt_first_replay = now;
+  }
+  if(verdict == VERDICT_ACCEPT) {
+    gt.fn++;
+    return;
+  }
+
+  gt.tp++;
+  if(gt.first_detection == 0) {
+    gt.first_detection = now;
+  }
+  if(stats != NULL && !stats->gt_detected) {
+    stats->gt_detected = 1;
+    ms = (uint32_t)((uint64_t)(now - stats->gt_first_replay) * 1000 /
+                    CLOCK_SECOND);
+    for(bucket = 0; ms > 0 && bucket < GT_HIST_BUCKETS - 1; bucket++) {
+      ms >>= 1;
+    }
+    gt.latency_hist[bucket]++;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Milliseconds from the first labelled replay to a later event, or 0 */
+static unsigned long
+gt_since_first_replay(clock_time_t t)
+{
+  if(t == 0 || gt.first_replay == 0) {
+    return 0;
+  }
+  return (unsigned long)((uint64_t)(t - gt.first_replay) * 1000 /
+                         CLOCK_SECOND);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Confusion matrix, detection times and the per-sender latency histogram */
+static void
+print_ground_truth(void)
+{
+  int i;
+  uint32_t flagged = gt.tp + gt.fp;
+  uint32_t replays = gt.tp + gt.fn;
+
+  LOG_INFO("\n--- Ground Truth ---\n");
+  LOG_INFO("              flagged   accepted\n");
+  LOG_INFO("replayed   %10lu %10lu\n",
+           (unsigned long)gt.tp, (unsigned long)gt.fn);
+  LOG_INFO("honest     %10lu %10lu\n",
+           (unsigned long)gt.fp, (unsigned long)gt.tn);
+  LOG_INFO("Precision/recall:    %.1f%% / %.1f%%\n",
+           flagged > 0 ? gt.tp * 100.0 / flagged : 0,
+           replays > 0 ? gt.tp * 100.0 / replays : 0);
+  LOG_INFO("First detection:     %lu ms after first replay\n",
+           gt_since_first_replay(gt.first_detection));
+  LOG_INFO("First blacklist:     %lu ms after first replay\n",
+           gt_since_first_replay(gt.first_blacklist));
+
+  /* tp,fp,tn,fn,ttfd_ms,ttbl_ms; 0 means "not yet" for the times */
+  LOG_INFO("[GT] %lu,%lu,%lu,%lu,%lu,%lu\n",
+           (unsigned long)gt.tp, (unsigned long)gt.fp,
+           (unsigned long)gt.tn, (unsigned long)gt.fn,
+           gt_since_first_replay(gt.first_detection),
+           gt_since_first_replay(gt.first_blacklist));
+  /* Bucket 0 is 0 ms, bucket b is [2^(b-1), 2^b) ms */
+  LOG_INFO("[GT-HIST] ");
+  for(i = 0; i < GT_HIST_BUCKETS; i++) {
+    LOG_INFO_("%s%lu", i > 0 ? "," : "", (unsigned long)gt.latency_hist[i]);
+  }
+  LOG_INFO_("\n");
+}
+#endif /* MITIGATION_CONF_WITH_GROUND_TRUTH */
+
+/*---------------------------------------------------------------------------*/
+/* Stats entry for a DIS/DAO sender. One never heard in a DIO gets the
+ * lowest pool priority, so DAO origins seen at the root cannot push out
+ * the DIO neighbors' history. */
+static node_stats_t *
+get_ctl_stats(const uip_ipaddr_t *addr)
+{
+  node_stats_t *stats = find_node_stats(addr, NULL);
+
+  if(stats == NULL) {
+    stats = pool_alloc(POOL_STATS, PRIO_CONTROL);
+    if(stats != NULL) {
+      uip_ipaddr_copy(&stats->sender, addr);
+    }
+  }
+  return stats;
+}
+
+/*---------------------------------------------------------------------------*/
+/* DAO sequence check: a sequence older than the newest one, or more copies
+ * of it than a DAO and its retransmissions account for, is a replay */
+static int
+dao_seq_replayed(ctl_stats_t *ctl, const uint8_t *body)
+{
+  uint8_t seq;
+
+  if(body + DAO_SEQ_OFFSET >= uip_buf + uip_len) {
+    return 0;
+  }
+  seq = body[DAO_SEQ_OFFSET];
+  if(ctl->repeats > 0 && seq == ctl->last_seq) {
+    if(ctl->repeats < 255) {
+      ctl->repeats++;
+    }
+    return ctl->repeats > DAO_MAX_REPEATS;
+  }
+  /* Lollipop order is ambiguous across a reboot; only flag clear cases */
+  if(ctl->repeats > 0 && RPL_LOLLIPOP_GREATER_THAN(ctl->last_seq, seq) &&
+     !RPL_LOLLIPOP_GREATER_THAN(seq, ctl->last_seq)) {
+    return 1;
+  }
+  ctl->last_seq = seq;
+  ctl->repeats = 1;
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Screen a DIS or DAO: blacklist, per-sender rate, and for DAOs the
+ * sequence number. DIS violations count towards the same blacklist as
+ * DIOs. A DAO's source is its origin, possibly many hops away, and a
+ * replay carries it unchanged: DAOs are only dropped, never held against
+ * the address they claim, so replays cannot get an honest origin listed. */
+static int
+ctl_screen(int type, const uint8_t *body)
+{
+  const uip_ipaddr_t *sender = &UIP_IP_BUF->srcipaddr;
+  ctl_counters_t *counters = &ctl_counters[type];
+  node_stats_t *stats;
+  ctl_stats_t *ctl;
+  uint32_t now = get_timestamp();
+
+  if(type == CTL_DIS && is_blacklisted(sender)) {
+    counters->blocked++;
+    return VERDICT_BLOCK;
+  }
+  stats = get_ctl_stats(sender);
+  if(stats == NULL) {
+    counters->untracked++;
+    return VERDICT_ACCEPT;
+  }
+
+  ctl = &stats->ctl[type];
+  if(type == CTL_DAO) {
+    if(dao_seq_replayed(ctl, body)) {
+      LOG_DBG("REPLAYED DAO from ");
+      LOG_DBG_6ADDR(sender);
+      LOG_DBG_(" (seq %u)\n", body[DAO_SEQ_OFFSET]);
+      counters->replay_drops++;
+      return VERDICT_REPLAY;
+    }
+    /* Only new sequence numbers use up the origin's rate: copies of the
+     * current one may be replays, and must not crowd out its next DAO */
+    if(ctl->repeats > 1) {
+      return VERDICT_ACCEPT;
+    }
+  }
+  if(ctl->window_start == 0 || now - ctl->window_start >= CTL_RATE_WINDOW) {
+    ctl->window_start = now;
+    ctl->count = 0;
+  }
+  if(ctl->count < 255) {
+    ctl->count++;
+  }
+  if(ctl->count > (type == CTL_DIS ? cfg.max_dis : cfg.max_dao)) {
+    counters->rate_drops++;
+    if(type == CTL_DAO) {
+      return VERDICT_REPLAY;
+    }
+    LOG_WARN("%s FLOOD from ", ctl_names[type]);
+    LOG_WARN_6ADDR(sender);
+    LOG_WARN_(" (%u in %us)\n", ctl->count, CTL_RATE_WINDOW);
+    count_violation(stats, now, "DIS flood");
+    return VERDICT_REPLAY;
+  }
+  return VERDICT_ACCEPT;
+}
+
+/*---------------------------------------------------------------------------*/
+static enum netstack_ip_action
+ctl_input(int type, const uint8_t *body)
+{
+  rtimer_clock_t start = RTIMER_NOW();
+  int verdict;
+
+  ctl_counters[type].received++;
+  verdict = ctl_screen(type, body);
+  ctl_counters[type].ticks += RTIMER_NOW() - start;
+  return verdict == VERDICT_ACCEPT ? NETSTACK_IP_PROCESS : NETSTACK_IP_DROP;
+}
+
+/*---------------------------------------------------------------------------*/
+/* IP packet processor: sees every packet right after 6LoWPAN decompression */
+static enum netstack_ip_action
+dio_tap_input(void)
+{
+  dio_info_t dio;
+  rtimer_clock_t start = RTIMER_NOW();
+  enum netstack_ip_action action = NETSTACK_IP_PROCESS;
+  int verdict;
+  uint32_t violations;
+  burst_entry_t *burst;
+  uint8_t *body;
+  unsigned i;
+  uint8_t digest[DIGEST_OPTION_LEN];
+  int has_digest;
+  int code = rpl_message_code(&body);
+  uip_ipaddr_t *parent;
+
+  /* Whatever rpl-lite does with this packet, the last DIO did not cause */
+  damp_cause = DAMP_IDLE;
+
+  if(code == RPL_CODE_DIS) {
+    return ctl_input(CTL_DIS, body);
+  }
+  if(code == RPL_CODE_DAO) {
+    /* Non-storing DAOs travel up to the root; forwarders are not the
+     * origin's neighbors and must not rate or sequence-check them */
+    if(!uip_ds6_is_my_addr(&UIP_IP_BUF->destipaddr)) {
+      ctl_forwarded++;
+      return NETSTACK_IP_PROCESS;
+    }
+    return ctl_input(CTL_DAO, body);
+  }
+  if(code != RPL_CODE_DIO || !parse_dio(&dio, body)) {
+    return NETSTACK_IP_PROCESS;
+  }
+
+  /* A blacklisted sender cannot make us track DODAGs it invents */
+  dio.dodag = dodag_find(dio.instance_id, &dio.dodag_id);
+  if(dio.dodag == NULL) {
+    dio.dodag = is_blacklisted(&dio.sender) ? &dodag_other :
+                dodag_get(dio.instance_id, &dio.dodag_id);
+  }
+  dio.dodag->last_heard = get_timestamp();
+  dio.dodag->dios++;
+  pool_pinned_dodag = dio.dodag;
+
+  burst = burst_get(&dio, dio_fingerprint(&dio), clock_time());
+  if(burst != NULL && burst->copies > 2 && burst->verdict != VERDICT_ACCEPT) {
+    verdict = burst_coalesce(&dio, burst);
+  } else {
+    violations = violations_total;
+    has_digest = digest_input(&dio, digest);
+    verdict = detect_replay_behavior(&dio);
+    /* A replayed DIO, or one from a listed sender, must not vote */
+    if(has_digest && verdict == VERDICT_ACCEPT &&
+       !is_blacklisted(&dio.sender)) {
+      digest_merge(&dio.sender, digest);
+    }
+    if(burst != NULL && burst->copies == 2) {
+      burst->verdict = verdict;
+      burst->hits = chain_hits;
+      burst->violations = violations_total - violations;
+      for(i = 0; i < DETECTOR_COUNT; i++) {
+        if(detectors[i] == &rate_detector && (chain_hits & (1 << i)) &&
+           burst->violations > 0) {
+          burst->violations--;
+        }
+      }
+    }
+    burst = NULL;
+  }
+  pool_pinned_dodag = NULL;
+  if(verdict != VERDICT_ACCEPT) {
+    dio.dodag->flagged++;
+  } else if(dio.dodag->dios - dio.dodag->flagged == 1 ||
+            RPL_LOLLIPOP_GREATER_THAN(dio.version, dio.dodag->version)) {
+    dio.dodag->version = dio.version;
+  }
+#if MITIGATION_CONF_WITH_GROUND_TRUTH
+  gt_record(&dio, verdict);
+#endif
+  if(verdict != VERDICT_ACCEPT) {
+    /* Flagged DIOs never reach RPL */
+    dio_dropped++;
+    action = NETSTACK_IP_DROP;
+    if(sched_tick > cfg.monitoring_interval) {
+      /* Backed off: tighten now rather than at the end of a long tick */
+      sched_tick = cfg.monitoring_interval;
+      sched_alert = 1;
+      process_poll(&dio_mitigation_process);
+    }
+  } else {
+    /* RPL runs synchronously after us; compare its state once it is done */
+    pre_dio_intcurrent = curr_instance.dag.dio_intcurrent;
+    pre_dio_parent = curr_instance.dag.preferred_parent;
+    uip_ipaddr_copy(&pre_dio_sender, &dio.sender);
+    /* A new version is a global repair, and our parent's resets are the
+     * ones Trickle exists to spread */
+    parent = curr_instance.dag.preferred_parent != NULL ?
+      rpl_neighbor_get_ipaddr(curr_instance.dag.preferred_parent) : NULL;
+    damp_cause = RPL_LOLLIPOP_GREATER_THAN(dio.version,
+                                           curr_instance.dag.version) ||
+      (parent != NULL && uip_ipaddr_cmp(parent, &dio.sender)) ?
+      DAMP_EXEMPT : DAMP_DIO;
+    process_poll(&dio_mitigation_process);
+  }
+
+  tap_ticks += RTIMER_NOW() - start;
+  if(burst != NULL) {
+    burst_ticks += RTIMER_NOW() - start;
+  }
+  return action;
+}
+
+/*---------------------------------------------------------------------------*/
+/* IP packet processor: sees every packet right before 6LoWPAN compression */
+static enum netstack_ip_action
+dio_tap_output(const linkaddr_t *localdest)
+{
+  uint8_t *body;
+
+  /* digest_append() edits a DIO without extension headers, which is how
+   * rpl-lite sends them */
+  if(rpl_message_code(&body) == RPL_CODE_DIO &&
+     body == &uip_buf[UIP_IPH_LEN + UIP_ICMPH_LEN]) {
+    digest_dios_sent++;
+    if(local_digest.entries > 0) {
+      digest_append();
+    } else if(digest_empty_repeats > 0) {
+      digest_empty_repeats--;
+      digest_append();
+    }
+    dio_tx_bytes += uip_len;
+  }
+  return NETSTACK_IP_PROCESS;
+}
 
-#define MAX_NODES 10
-static node_stats_t node_stats[MAX_NODES];
+static struct netstack_ip_packet_processor dio_tap_processor = {
+  .process_input = dio_tap_input,
+  .process_output = dio_tap_output
+};
 
+#if MITIGATION_CONF_WITH_LL_FILTER
 /*---------------------------------------------------------------------------*/
+/* Network driver in front of 6LoWPAN: the MAC has parsed the frame header,
+ * so the sender is known before any decompression or copying */
 static void
-init_blacklist(void)
+ll_filter_init(void)
 {
-  memset(blacklist, 0, sizeof(blacklist));
-  blacklist_count = 0;
-  LOG_INFO("Blacklist initialized (size: %d, threshold: %d)\n", 
-           BLACKLIST_SIZE, BLACKLIST_THRESHOLD);
+  sicslowpan_driver.init();
 }
 
 /*---------------------------------------------------------------------------*/
 static void
-init_cache(void)
+ll_filter_input(void)
 {
-  memset(dio_cache, 0, sizeof(dio_cache));
-  memset(node_stats, 0, sizeof(node_stats));
-  init_blacklist();
-  random_init(linkaddr_node_addr.u8[0]);
-  LOG_INFO("Mitigation cache initialized (size: %d)\n", DIO_CACHE_SIZE);
+  const linkaddr_t *sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  rtimer_clock_t start = RTIMER_NOW();
+  uint32_t dropped = dio_dropped;
+  uint8_t i;
+
+  ll_frames++;
+  for(i = 0; i < ll_deny_count; i++) {
+    if(linkaddr_cmp(&ll_deny[i].addr, sender)) {
+      /* Rechecked through the blacklist so temporary entries still expire */
+      if(is_blacklisted(&ll_deny[i].entry->addr)) {
+        ll_dropped++;
+        ll_drop_ticks += RTIMER_NOW() - start;
+        return;
+      }
+      break;
+    }
+  }
+
+  sicslowpan_driver.input();
+  if(dio_dropped != dropped) {
+    /* What the same frame costs when the IP tap has to reject it */
+    ll_tap_drops++;
+    ll_tap_drop_ticks += RTIMER_NOW() - start;
+  }
 }
 
 /*---------------------------------------------------------------------------*/
-static uint32_t
-get_timestamp(void)
+static uint8_t
+ll_filter_output(const linkaddr_t *localdest)
 {
-  return (uint32_t)clock_seconds();
+  return sicslowpan_driver.output(localdest);
 }
 
+const struct network_driver mitigation_network_driver = {
+  "mitigation",
+  ll_filter_init,
+  ll_filter_input,
+  ll_filter_output
+};
+
 /*---------------------------------------------------------------------------*/
-/* Check if a node is blacklisted */
-static int
-is_blacklisted(const uip_ipaddr_t *addr)
+/* Link-layer drops and the CPU time they saved */
+static void
+print_ll_filter(void)
 {
-  int i;
-  uint32_t current_time = get_timestamp();
-  
-  for(i = 0; i < BLACKLIST_SIZE; i++) {
-    if(blacklist[i].active && uip_ipaddr_cmp(&blacklist[i].addr, addr)) {
-      /* Check if temporary blacklist has expired */
-      if(!blacklist[i].permanent) {
-        if(current_time - blacklist[i].blacklist_time > BLACKLIST_DURATION) {
-          blacklist[i].active = 0;
-          LOG_INFO("Blacklist expired for ");
-          LOG_INFO_6ADDR(addr);
-          LOG_INFO_("\n");
-          return 0;
-        }
-      }
-      return 1;
-    }
-  }
-  return 0;
+  unsigned long drop_us = ll_dropped > 0 ?
+    (unsigned long)((uint64_t)ll_drop_ticks * 1000000 /
+                    RTIMER_SECOND / ll_dropped) : 0;
+  unsigned long tap_us = ll_tap_drops > 0 ?
+    (unsigned long)((uint64_t)ll_tap_drop_ticks * 1000000 /
+                    RTIMER_SECOND / ll_tap_drops) : 0;
+  unsigned long saved_us = tap_us > drop_us ? tap_us - drop_us : 0;
+
+  LOG_INFO("\n--- Link-Layer Filter ---\n");
+  LOG_INFO("Deny set:            %u link addresses\n", ll_deny_count);
+  LOG_INFO("Frames:              %lu seen, %lu dropped early\n",
+           (unsigned long)ll_frames, (unsigned long)ll_dropped);
+  LOG_INFO("Early drop cost:     %lu us/frame\n", drop_us);
+  LOG_INFO("IP tap drop cost:    %lu us/frame (%lu frames)\n",
+           tap_us, (unsigned long)ll_tap_drops);
+  LOG_INFO("Saved:               %lu us/frame, %lu ms total\n",
+           saved_us, (unsigned long)((uint64_t)saved_us * ll_dropped / 1000));
 }
+#endif /* MITIGATION_CONF_WITH_LL_FILTER */
 
 /*---------------------------------------------------------------------------*/
-/* Add a node to the blacklist */
+/* Sender with violations in the last blacklist term, still below the
+ * blacklist threshold */
 static int
-add_to_blacklist(const uip_ipaddr_t *addr, const char *reason, int permanent)
+is_suspect(const node_stats_t *stats)
 {
-  int i;
-  int empty_slot = -1;
-  uint32_t oldest_time = 0xFFFFFFFF;
-  int oldest_slot = 0;
-  
-  /* Check if already blacklisted */
-  for(i = 0; i < BLACKLIST_SIZE; i++) {
-    if(blacklist[i].active && uip_ipaddr_cmp(&blacklist[i].addr, addr)) {
-      /* Update existing entry */
-      blacklist[i].violation_count++;
-      blacklist[i].blacklist_time = get_timestamp();
-      if(permanent) {
-        blacklist[i].permanent = 1;
-      }
-      LOG_WARN("Updated blacklist entry for ");
-      LOG_WARN_6ADDR(addr);
-      LOG_WARN_(" (violations: %lu)\n", 
-                (unsigned long)blacklist[i].violation_count);
-      return 1;
-    }
-    
-    /* Track empty and oldest slots */
-    if(!blacklist[i].active && empty_slot == -1) {
-      empty_slot = i;
-    }
-    if(blacklist[i].blacklist_time < oldest_time) {
-      oldest_time = blacklist[i].blacklist_time;
-      oldest_slot = i;
-    }
-  }
-  
-  /* Use empty slot or replace oldest */
-  i = (empty_slot != -1) ? empty_slot : oldest_slot;
-  
-  uip_ipaddr_copy(&blacklist[i].addr, addr);
-  blacklist[i].blacklist_time = get_timestamp();
-  blacklist[i].violation_count = 1;
-  blacklist[i].permanent = permanent;
-  blacklist[i].active = 1;
-  strncpy(blacklist[i].reason, reason, sizeof(blacklist[i].reason) - 1);
-  
-  blacklist_count++;
-  nodes_blacklisted++;
-  
-  LOG_WARN("⛔ BLACKLISTED: ");
-  LOG_WARN_6ADDR(addr);
-  LOG_WARN_(" | Reason: %s | %s\n", 
-            reason, permanent ? "PERMANENT" : "TEMPORARY");
-  
-  return 1;
+  return cfg.quarantine_threshold > 0 &&
+    stats->violation_count >= cfg.quarantine_threshold &&
+    get_timestamp() - stats->last_violation <= cfg.blacklist_duration;
 }
 
 /*---------------------------------------------------------------------------*/
-/* Remove a node from the blacklist (manual unblock) */
+/* Suspects, and blacklisted senders RPL has not aged out yet */
 static int
-remove_from_blacklist(const uip_ipaddr_t *addr)
+is_quarantined(rpl_nbr_t *nbr)
 {
-  int i;
-  
-  for(i = 0; i < BLACKLIST_SIZE; i++) {
-    if(blacklist[i].active && uip_ipaddr_cmp(&blacklist[i].addr, addr)) {
-      blacklist[i].active = 0;
-      LOG_INFO("Removed from blacklist: ");
-      LOG_INFO_6ADDR(addr);
-      LOG_INFO_("\n");
-      return 1;
-    }
+  const node_stats_t *stats;
+  uip_ipaddr_t *addr = rpl_neighbor_get_ipaddr(nbr);
+
+  if(addr == NULL || cfg.quarantine_threshold == 0) {
+    return 0;
   }
-  return 0;
+  if(blacklist_find(addr) != NULL) {
+    return 1;
+  }
+  /* Only what the neighbor did in this DODAG counts against it here */
+  stats = find_node_stats(addr, dodag_current());
+  return stats != NULL && is_suspect(stats);
 }
 
 /*---------------------------------------------------------------------------*/
-/* Print blacklist table */
-static void
-print_blacklist(void)
+/* The base OF picks; a quarantined winner must also beat a trusted rival,
+ * in particular the current parent, by cfg.quarantine_margin path cost */
+static rpl_nbr_t *
+quarantine_best_parent(rpl_nbr_t *nbr1, rpl_nbr_t *nbr2)
 {
-  int i;
-  int active_count = 0;
-  uint32_t current_time = get_timestamp();
-  
-  LOG_INFO("\n╔════════════════════════════════════════════╗\n");
-  LOG_INFO("║           BLACKLIST TABLE                  ║\n");
-  LOG_INFO("╚════════════════════════════════════════════╝\n");
-  
-  for(i = 0; i < BLACKLIST_SIZE; i++) {
-    if(blacklist[i].active) {
-      active_count++;
-      uint32_t age = current_time - blacklist[i].blacklist_time;
-      
-      LOG_INFO("%d. ", active_count);
-      LOG_INFO_6ADDR(&blacklist[i].addr);
-      LOG_INFO_("\n");
-      LOG_INFO("   Reason: %s\n", blacklist[i].reason);
-      LOG_INFO("   Type: %s\n", 
-               blacklist[i].permanent ? "PERMANENT" : "TEMPORARY");
-      LOG_INFO("   Violations: %lu\n", 
-               (unsigned long)blacklist[i].violation_count);
-      LOG_INFO("   Age: %lus", (unsigned long)age);
-      
-      if(!blacklist[i].permanent) {
-        uint32_t remaining = BLACKLIST_DURATION - age;
-        LOG_INFO_(" (expires in %lus)", (unsigned long)remaining);
-      }
-      LOG_INFO_("\n\n");
+  rpl_nbr_t *best = quarantine_base->best_parent(nbr1, nbr2);
+  rpl_nbr_t *rival = best == nbr1 ? nbr2 : nbr1;
+
+  if(best == NULL || rival == NULL || !is_quarantined(best) ||
+     is_quarantined(rival) || !quarantine_base->nbr_has_usable_link(rival)) {
+    return best;
+  }
+  if((uint32_t)quarantine_base->nbr_path_cost(best) + cfg.quarantine_margin <
+     quarantine_base->nbr_path_cost(rival)) {
+    if(rival == curr_instance.dag.preferred_parent) {
+      quarantine_yielded++;
     }
+    return best;
   }
-  
-  if(active_count == 0) {
-    LOG_INFO("   (empty)\n");
+  if(rival == curr_instance.dag.preferred_parent) {
+    quarantine_held++;
   }
-  
-  LOG_INFO("Active entries: %d/%d\n", active_count, BLACKLIST_SIZE);
-  LOG_INFO("════════════════════════════════════════════\n");
+  return rival;
 }
 
 /*---------------------------------------------------------------------------*/
-/* Find or create node stats entry */
-static node_stats_t *
-get_node_stats(const uip_ipaddr_t *addr)
+/* Wrap the OF RPL picked for the instance; redone after every (re)join,
+ * since joining installs the plain OF again */
+static void
+quarantine_attach(void)
 {
-  int i;
-  node_stats_t *oldest = &node_stats[0];
-  
-  for(i = 0; i < MAX_NODES; i++) {
-    if(uip_ipaddr_cmp(&node_stats[i].sender, addr)) {
-      return &node_stats[i];
-    }
-    if(node_stats[i].last_seen < oldest->last_seen) {
-      oldest = &node_stats[i];
-    }
+  if(curr_instance.of == NULL || curr_instance.of == &quarantine_of) {
+    return;
   }
-  
-  memset(oldest, 0, sizeof(node_stats_t));
-  uip_ipaddr_copy(&oldest->sender, addr);
-  return oldest;
+  quarantine_base = curr_instance.of;
+  quarantine_of = *quarantine_base;
+  quarantine_of.best_parent = quarantine_best_parent;
+  curr_instance.of = &quarantine_of;
 }
 
+#if MITIGATION_TRICKLE_HOOK
 /*---------------------------------------------------------------------------*/
-/* Detect replay based on behavioral analysis */
-static int
-detect_replay_behavior(const uip_ipaddr_t *sender, uint16_t rank, 
-                       uint8_t version)
+/* rpl-lite is resetting Trickle for a DIO from pre_dio_sender. Within its
+ * budget the reset stands; past it, or from a suspect, the interval goes
+ * back to where it was. The shortened interval rpl-lite just armed then
+ * ends without a DIO, as if suppressed, and doubling resumes from
+ * 'restore'. */
+static void
+trickle_damp(uint8_t restore)
 {
-  uint32_t current_time = get_timestamp();
-  node_stats_t *stats = get_node_stats(sender);
-  int is_replay = 0;
-  
-  dio_received++;
-  
-  /* Check blacklist first */
-  if(is_blacklisted(sender)) {
-    dio_blocked_blacklist++;
-    LOG_WARN("🚫 BLOCKED (blacklisted): ");
-    LOG_WARN_6ADDR(sender);
-    LOG_WARN_("\n");
-    return 2; /* Special code for blacklisted */
-  }
-  
-  /* Reset counter every second */
-  if(stats->last_count_reset != current_time) {
-    stats->dio_count_per_sec = 0;
-    stats->last_count_reset = current_time;
+  node_stats_t *stats;
+  uint32_t now = get_timestamp();
+  uint8_t saved = restore - curr_instance.dio_intmin;
+
+  if(cfg.reset_budget == 0 ||
+     (stats = find_node_stats(&pre_dio_sender, dodag_current())) == NULL) {
+    return;
   }
-  
-  stats->dio_count_per_sec++;
-  
-  /* Detect high-frequency DIOs (replay attack signature) */
-  if(stats->dio_count_per_sec > 3) {
-    LOG_WARN("HIGH FREQUENCY DIOs from ");
-    LOG_WARN_6ADDR(sender);
-    LOG_WARN_(" (%u DIOs/sec) - REPLAY ATTACK!\n", stats->dio_count_per_sec);
-    is_replay = 1;
-    dio_suspicious++;
-    stats->violation_count++;
-    
-    /* Auto-blacklist if threshold reached */
-    if(AUTO_BLACKLIST_ENABLED && 
-       stats->violation_count >= BLACKLIST_THRESHOLD) {
-      add_to_blacklist(sender, "High frequency attack", 0);
-    }
+  if(now - stats->reset_window_start >= cfg.reset_window) {
+    stats->reset_window_start = now;
+    stats->reset_count = 0;
   }
-  
-  /* Detect duplicate rank/version (replay signature) */
-  if(stats->last_seen > 0) {
-    uint32_t time_diff = current_time - stats->last_seen;
-    
-    if(stats->last_rank == rank && 
-       stats->last_version == version &&
-       time_diff < 5) {
-      LOG_WARN("DUPLICATE DIO from ");
-      LOG_WARN_6ADDR(sender);
-      LOG_WARN_(" (rank: %u, ver: %u, %lus ago) - REPLAY!\n", 
-               rank, version, (unsigned long)time_diff);
-      is_replay = 1;
-      stats->violation_count++;
-      
-      /* Auto-blacklist if threshold reached */
-      if(AUTO_BLACKLIST_ENABLED && 
-         stats->violation_count >= BLACKLIST_THRESHOLD) {
-        add_to_blacklist(sender, "Duplicate replay", 0);
-      }
-    }
+  if(!is_suspect(stats) && stats->reset_count < cfg.reset_budget) {
+    stats->reset_count++;
+    return;
   }
-  
-  /* Update stats */
-  stats->last_seen = current_time;
-  stats->last_rank = rank;
-  stats->last_version = version;
-  
-  if(is_replay) {
-    dio_replayed++;
+
+  curr_instance.dag.dio_intcurrent = restore;
+  if(curr_instance.dio_redundancy > 0 &&
+     curr_instance.dag.rank != ROOT_RANK) {
+    curr_instance.dag.dio_counter = curr_instance.dio_redundancy;
   } else {
-    dio_accepted++;
+    saved--; /* The early DIO goes out regardless */
   }
-  
-  return is_replay;
+  if(resets_damped++ == 0) {
+    damp_first = now;
+  }
+  /* One DIO per interval from Imin up to 'restore' would have gone out */
+  damp_dios_saved += saved;
+  LOG_INFO("Trickle reset damped (%s, %u DIOs saved): ",
+           is_suspect(stats) ? "suspect" : "over budget", saved);
+  LOG_INFO_6ADDR(&pre_dio_sender);
+  LOG_INFO_("\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* rpl-lite calls this each time it starts a Trickle interval, right after
+ * arming the timer and before it returns to the DIO that caused it */
+void
+RPL_CALLBACK_NEW_DIO_INTERVAL(clock_time_t dio_interval)
+{
+  /* Trickle only shrinks its interval on a reset */
+  if(curr_instance.dag.dio_intcurrent < damp_intcurrent &&
+     damp_cause != DAMP_IDLE) {
+    trickle_resets++;
+    if(damp_cause == DAMP_EXEMPT) {
+      resets_exempt++;
+    } else {
+      trickle_damp(damp_intcurrent);
+    }
+    /* One reset per DIO; a second one has another cause */
+    damp_cause = DAMP_IDLE;
+  }
+  damp_intcurrent = curr_instance.dag.dio_intcurrent;
 }
+#endif /* MITIGATION_TRICKLE_HOOK */
 
 /*---------------------------------------------------------------------------*/
-/* Monitor RPL neighbor table */
+/* Count Trickle resets and parent changes caused by the last accepted DIO */
 static void
-monitor_rpl_neighbors(void)
+check_rpl_side_effects(void)
 {
-  rpl_nbr_t *nbr;
-  static uint32_t last_check = 0;
-  uint32_t current_time = get_timestamp();
-  
+  /* rpl-lite is done with the DIO */
+  damp_cause = DAMP_IDLE;
   if(curr_instance.dag.state < DAG_INITIALIZED) {
     return;
   }
-  
-  /* Only check if time has progressed */
-  if(current_time == last_check) {
-    return;
+  quarantine_attach();
+#if !MITIGATION_TRICKLE_HOOK
+  /* Trickle only shrinks its interval on a reset; without the hook it is
+   * too late to undo, so resets are only counted */
+  if(curr_instance.dag.dio_intcurrent < pre_dio_intcurrent) {
+    trickle_resets++;
   }
-  last_check = current_time;
-  
-  /* Iterate through all neighbors */
-  nbr = nbr_table_head(rpl_neighbors);
-  while(nbr != NULL) {
-    uip_ipaddr_t *addr = rpl_neighbor_get_ipaddr(nbr);
-    uint16_t rank = nbr->rank;
-    
-    if(addr != NULL && rank < 0xFFFF) {
-      detect_replay_behavior(addr, rank, curr_instance.dag.version);
+#endif
+  if(pre_dio_parent != NULL &&
+     curr_instance.dag.preferred_parent != pre_dio_parent) {
+    parent_changes++;
+  }
+  pre_dio_intcurrent = curr_instance.dag.dio_intcurrent;
+  pre_dio_parent = curr_instance.dag.preferred_parent;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Per message type: traffic, drops, tap CPU per message, and the RAM the
+ * type adds to every tracked sender plus its global counters */
+static void
+print_control_costs(void)
+{
+  int i;
+  const ctl_counters_t *c;
+
+  LOG_INFO("\n--- RPL Control Screening ---\n");
+  LOG_INFO("DIO: rx=%lu dropped=%lu avg=%lu us, %u B/sender\n",
+           (unsigned long)dio_received, (unsigned long)dio_dropped,
+           dio_received > 0 ?
+           (unsigned long)((uint64_t)tap_ticks * 1000000 /
+                           RTIMER_SECOND / dio_received) : 0,
+           (unsigned)(sizeof(node_stats_t) - CTL_TYPES * sizeof(ctl_stats_t)));
+  for(i = 0; i < CTL_TYPES; i++) {
+    c = &ctl_counters[i];
+    LOG_INFO("%s: rx=%lu rate=%lu replay=%lu listed=%lu untracked=%lu avg=%lu us, %u B/sender + %u B\n",
+             ctl_names[i], (unsigned long)c->received,
+             (unsigned long)c->rate_drops, (unsigned long)c->replay_drops,
+             (unsigned long)c->blocked, (unsigned long)c->untracked,
+             c->received > 0 ?
+             (unsigned long)((uint64_t)c->ticks * 1000000 /
+                             RTIMER_SECOND / c->received) : 0,
+             (unsigned)sizeof(ctl_stats_t), (unsigned)sizeof(ctl_counters_t));
+  }
+  LOG_INFO("DAO: forwarded unscreened=%lu\n", (unsigned long)ctl_forwarded);
+}
+
+/*---------------------------------------------------------------------------*/
+/* DIOs judged from their burst record, and the tap time per DIO on either
+ * path */
+static void
+print_burst_coalescing(void)
+{
+  uint32_t full = dio_received - burst_coalesced;
+
+  LOG_INFO("\n--- Burst Coalescing ---\n");
+  LOG_INFO("Coalesced:           %lu DIOs in %lu bursts (%lu%% of received)\n",
+           (unsigned long)burst_coalesced, (unsigned long)burst_records,
+           dio_received > 0 ?
+           (unsigned long)((uint64_t)burst_coalesced * 100 / dio_received) : 0);
+  LOG_INFO("Tap time per DIO:    %lu us judged, %lu us coalesced\n",
+           full > 0 ?
+           (unsigned long)((uint64_t)(tap_ticks - burst_ticks) * 1000000 /
+                           RTIMER_SECOND / full) : 0,
+           burst_coalesced > 0 ?
+           (unsigned long)((uint64_t)burst_ticks * 1000000 /
+                           RTIMER_SECOND / burst_coalesced) : 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Resets damped and the DIO airtime they saved, also per hour since the
+ * first damped reset */
+static void
+print_trickle_damping(void)
+{
+  uint32_t dio_bytes = digest_dios_sent > 0 ?
+    dio_tx_bytes / digest_dios_sent - UIP_IPH_LEN + DIO_FRAME_OVERHEAD : 0;
+  uint32_t saved_us = damp_dios_saved * dio_bytes * TX_US_PER_BYTE;
+  uint32_t span = get_timestamp() - damp_first;
+
+  LOG_INFO("Resets damped:       %lu, %lu DIOs saved (%s, %lu exempt)\n",
+           (unsigned long)resets_damped, (unsigned long)damp_dios_saved,
+           MITIGATION_TRICKLE_HOOK ? "hooked" : "no rpl-lite hook",
+           (unsigned long)resets_exempt);
+  if(resets_damped > 0 && dio_bytes > 0) {
+    LOG_INFO("  - TX time saved:   %lu ms (%lu ms/h, %lu B/DIO on air)\n",
+             (unsigned long)(saved_us / 1000),
+             span > 0 ? (unsigned long)((uint64_t)saved_us * 3600 / span / 1000) :
+             (unsigned long)(saved_us / 1000),
+             (unsigned long)dio_bytes);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* One line with the counters the baseline node prints under the same tag:
+ * role,secs,dio_rx,dio_passed,dio_dropped,tap_us,resets,parent_sw,cpu,lpm,tx,rx
+ * Energest values are ticks since the previous [AB] line. */
+static void
+print_ab_line(void)
+{
+  uint64_t cpu, lpm, tx, rx;
+  uint32_t now = get_timestamp();
+
+  energest_flush();
+  cpu = energest_type_time(ENERGEST_TYPE_CPU);
+  lpm = energest_type_time(ENERGEST_TYPE_LPM);
+  tx = energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  rx = energest_type_time(ENERGEST_TYPE_LISTEN);
+
+  LOG_INFO("[AB] mitigation,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+           (unsigned long)(now - last_report_time),
+           (unsigned long)dio_received,
+           (unsigned long)(dio_received - dio_dropped),
+           (unsigned long)dio_dropped,
+           (unsigned long)((uint64_t)tap_ticks * 1000000 / RTIMER_SECOND),
+           (unsigned long)trickle_resets,
+           (unsigned long)parent_changes,
+           (unsigned long)(cpu - last_cpu),
+           (unsigned long)(lpm - last_lpm),
+           (unsigned long)(tx - last_tx),
+           (unsigned long)(rx - last_rx));
+
+  last_cpu = cpu;
+  last_lpm = lpm;
+  last_tx = tx;
+  last_rx = rx;
+  last_report_time = now;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Wakeup rate and LPM residency, to compare builds with and without
+ * MITIGATION_CONF_LOW_POWER */
+static void
+print_scheduler(void)
+{
+  uint64_t cpu, lpm;
+  uint32_t uptime = get_timestamp();
+  unsigned long lpm_permille;
+
+  energest_flush();
+  cpu = energest_type_time(ENERGEST_TYPE_CPU);
+  lpm = energest_type_time(ENERGEST_TYPE_LPM);
+  lpm_permille = cpu + lpm > 0 ?
+    (unsigned long)(lpm * 1000 / (cpu + lpm)) : 0;
+
+  LOG_INFO("\n--- Scheduler ---\n");
+  LOG_INFO("Mode:                %s\n",
+           MITIGATION_CONF_LOW_POWER ? "LOW-POWER" : "FIXED");
+  LOG_INFO("Tick:                %us (min %u)\n",
+           sched_tick, cfg.monitoring_interval);
+  LOG_INFO("Timer wakeups:       %lu (%lu/h)\n",
+           (unsigned long)sched_wakeups,
+           uptime > 0 ? (unsigned long)((uint64_t)sched_wakeups * 3600 /
+                                        uptime) : 0);
+  LOG_INFO("LPM residency:       %lu.%lu%%\n",
+           lpm_permille / 10, lpm_permille % 10);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Per-DODAG traffic; detector state never crosses these lines */
+static void
+print_dodags(void)
+{
+  dodag_entry_t *dodag;
+  node_stats_t *stats;
+  int senders;
+
+  LOG_INFO("\n--- DODAGs ---\n");
+  for(dodag = list_head(dodags); dodag != NULL;
+      dodag = list_item_next(dodag)) {
+    senders = 0;
+    for(stats = list_head(node_stats); stats != NULL;
+        stats = list_item_next(stats)) {
+      senders += stats->dodag == dodag;
     }
-    
-    nbr = nbr_table_next(rpl_neighbors, nbr);
+    LOG_INFO("%s instance %u ", dodag_is_current(dodag) ? "*" : " ",
+             dodag->instance_id);
+    LOG_INFO_6ADDR(&dodag->dodag_id);
+    LOG_INFO_(" v%u: %lu DIOs, %lu flagged, %d senders\n", dodag->version,
+              (unsigned long)dodag->dios, (unsigned long)dodag->flagged,
+              senders);
+  }
+  if(dodag_other.dios > 0) {
+    LOG_INFO("  untracked: %lu DIOs, %lu flagged\n",
+             (unsigned long)dodag_other.dios,
+             (unsigned long)dodag_other.flagged);
   }
 }
 
@@ -385,23 +3469,16 @@ monitor_rpl_neighbors(void)
 static void
 print_statistics(void)
 {
-  int i;
+  node_stats_t *stats;
   int active_nodes = 0;
-  int blacklisted_nodes = 0;
-  uint32_t total_replays = dio_replayed + dio_suspicious;
   
-  for(i = 0; i < MAX_NODES; i++) {
-    if(node_stats[i].last_seen > 0) {
+  for(stats = list_head(node_stats); stats != NULL;
+      stats = list_item_next(stats)) {
+    if(stats->last_seen > 0) {
       active_nodes++;
     }
   }
   
-  for(i = 0; i < BLACKLIST_SIZE; i++) {
-    if(blacklist[i].active) {
-      blacklisted_nodes++;
-    }
-  }
-  
   LOG_INFO("╔════════════════════════════════════════════╗\n");
   LOG_INFO("║   DIO REPLAY MITIGATION STATISTICS         ║\n");
   LOG_INFO("╚════════════════════════════════════════════╝\n");
@@ -409,94 +3486,297 @@ print_statistics(void)
   LOG_INFO("DIOs accepted:       %lu (%.1f%%)\n", 
            (unsigned long)dio_accepted,
            dio_received > 0 ? (dio_accepted * 100.0) / dio_received : 0);
+  /* Each DIO is counted once, by its final verdict; per-detector hits,
+   * which overlap, are in the detector chain table */
   LOG_INFO("Replays detected:    %lu (%.1f%%)\n", 
-           (unsigned long)total_replays,
-           dio_received > 0 ? (total_replays * 100.0) / dio_received : 0);
+           (unsigned long)dio_replayed,
+           dio_received > 0 ? (dio_replayed * 100.0) / dio_received : 0);
   LOG_INFO("  - High frequency:  %lu\n", (unsigned long)dio_suspicious);
-  LOG_INFO("  - Duplicates:      %lu\n", (unsigned long)dio_replayed);
-  LOG_INFO("DIOs blocked (BL):   %lu\n", (unsigned long)dio_blocked_blacklist);
+  LOG_INFO("DIOs blocked:        %lu\n",
+           (unsigned long)(dio_dropped - dio_replayed));
+  LOG_INFO("  - Blacklisted:     %lu\n", (unsigned long)dio_blocked_blacklist);
+  LOG_INFO("DIOs dropped:        %lu\n", (unsigned long)dio_dropped);
   LOG_INFO("\n--- Blacklist Status ---\n");
-  LOG_INFO("Active blacklist:    %d/%d\n", blacklisted_nodes, BLACKLIST_SIZE);
+  LOG_INFO("Active blacklist:    %u/%d\n",
+           pool_tables[POOL_BLACKLIST].used, BLACKLIST_SIZE);
   LOG_INFO("Total blacklisted:   %lu\n", (unsigned long)nodes_blacklisted);
   LOG_INFO("Active nodes:        %d/%d\n", active_nodes, MAX_NODES);
-  LOG_INFO("Cache usage:         %d/%d\n", cache_index, DIO_CACHE_SIZE);
+  print_dodags();
+  LOG_INFO("\n--- Detection Policy ---\n");
+  LOG_INFO("Policy:              %s\n",
+           cfg.policy == POLICY_ADAPTIVE ? "ADAPTIVE" : "STATIC");
+  LOG_INFO("Churn score:         %u (high at %u)\n", churn_score, CHURN_HIGH);
+  LOG_INFO("Rate limit:          %u DIOs/sec\n", adaptive_rate_limit());
+  LOG_INFO("Net DIO interval:    %lu.%02lus (EWMA)\n",
+           (unsigned long)(net_interval_ewma >> INTERVAL_FRAC_BITS),
+           (unsigned long)(((net_interval_ewma & 0xF) * 100) >> INTERVAL_FRAC_BITS));
+  LOG_INFO("\n--- Blacklist Digest ---\n");
+  LOG_INFO("Local digest:        gen=%u entries=%u\n",
+           local_digest.generation, local_digest.entries);
+  LOG_INFO("Digests rx/merged:   %lu/%lu (rejected: %lu, remote hits: %lu)\n",
+           (unsigned long)digest_received, (unsigned long)digest_merged,
+           (unsigned long)digest_rejected, (unsigned long)digest_remote_hits);
+  LOG_INFO("DIOs tagged/sent:    %lu/%lu\n",
+           (unsigned long)digest_dios_tagged, (unsigned long)digest_dios_sent);
+  LOG_INFO("Digest overhead:     %lu bytes (%.1f B/DIO)\n",
+           (unsigned long)digest_bytes_added,
+           digest_dios_sent > 0 ? 
+           (double)digest_bytes_added / digest_dios_sent : 0);
   
-  if(dio_received > 0 && total_replays > 0) {
+  if(dio_received > 0 && dio_replayed > 0) {
     LOG_INFO("\n⚠️  REPLAY ATTACK IN PROGRESS! ⚠️\n");
     LOG_INFO("Attack intensity:    %.1f%% of traffic\n",
-             (total_replays * 100.0) / dio_received);
+             (dio_replayed * 100.0) / dio_received);
   }
   
+  print_detector_costs();
+  print_burst_coalescing();
+  print_control_costs();
+#if MITIGATION_CONF_WITH_GROUND_TRUTH
+  print_ground_truth();
+#endif
+  
+  print_scheduler();
+  print_pool();
+#if MITIGATION_CONF_WITH_LL_FILTER
+  print_ll_filter();
+#endif
+#if MITIGATION_CONF_WITH_CFS
+  LOG_INFO("\n--- Checkpoints ---\n");
+  LOG_INFO("Flash writes:        %lu (%lu/h), %lu bytes, %lu failed\n",
+           (unsigned long)state_writes,
+           get_timestamp() > 0 ?
+           (unsigned long)((uint64_t)state_writes * 3600 / get_timestamp()) : 0,
+           (unsigned long)state_bytes, (unsigned long)state_write_errors);
+  LOG_INFO("Pending:             %s\n",
+           (state_dirty & STATE_DIRTY_BLACKLIST) ? "blacklist" :
+           state_dirty ? "counters" : "none");
+#endif
+  
+  LOG_INFO("\n--- RPL Side Effects ---\n");
+  LOG_INFO("Tap time:            %lu us/DIO\n", dio_received > 0 ?
+           (unsigned long)((uint64_t)tap_ticks * 1000000 /
+                           RTIMER_SECOND / dio_received) : 0);
+  LOG_INFO("Trickle resets:      %lu\n", (unsigned long)trickle_resets);
+  LOG_INFO("Parent changes:      %lu\n", (unsigned long)parent_changes);
+  print_trickle_damping();
+  LOG_INFO("Quarantine:          %s, %lu held, %lu yielded\n",
+           quarantine_base != NULL ? "on" : "off",
+           (unsigned long)quarantine_held,
+           (unsigned long)quarantine_yielded);
+  
   LOG_INFO("\n--- Per-Node Analysis ---\n");
-  for(i = 0; i < MAX_NODES; i++) {
-    if(node_stats[i].last_seen > 0) {
+  for(stats = list_head(node_stats); stats != NULL;
+      stats = list_item_next(stats)) {
+    if(stats->last_seen > 0) {
       LOG_INFO("Node ");
-      LOG_INFO_6ADDR(&node_stats[i].sender);
+      LOG_INFO_6ADDR(&stats->sender);
       
-      if(is_blacklisted(&node_stats[i].sender)) {
+      if(is_blacklisted(&stats->sender)) {
         LOG_INFO_(" [BLACKLISTED]");
+      } else if(is_suspect(stats)) {
+        LOG_INFO_(" [QUARANTINED]");
       }
       
-      LOG_INFO_(": rank=%u ver=%u rate=%u/s violations=%lu age=%lus\n",
-               node_stats[i].last_rank,
-               node_stats[i].last_version,
-               node_stats[i].dio_count_per_sec,
-               (unsigned long)node_stats[i].violation_count,
-               (unsigned long)(get_timestamp() - node_stats[i].last_seen));
+      LOG_INFO_(": rank=%u ver=%u rate=%u/s ivl=%lus violations=%lu age=%lus\n",
+               stats->last_rank,
+               stats->last_version,
+               stats->dio_count_per_sec,
+               (unsigned long)(stats->interval_ewma >> INTERVAL_FRAC_BITS),
+               (unsigned long)stats->violation_count,
+               (unsigned long)(get_timestamp() - stats->last_seen));
     }
   }
   LOG_INFO("════════════════════════════════════════════\n");
+  print_ab_line();
+}
+
+/*---------------------------------------------------------------------------*/
+#if MITIGATION_CONF_WITH_SHELL
+/* Shell front-end: "mitcfg [<name> <value>|save|load|defaults]" */
+static
+PT_THREAD(cmd_mitcfg(struct pt *pt, shell_output_func output, char *args))
+{
+  static char reply[160];
+
+  PT_BEGIN(pt);
+
+  config_command(args != NULL ? args : "", reply, sizeof(reply));
+  SHELL_OUTPUT(output, "%s\n", reply);
+
+  PT_END(pt);
 }
 
+static const struct shell_command_t mitigation_shell_commands[] = {
+  { "mitcfg", cmd_mitcfg,
+    "'> mitcfg [<name> <value>|save|load|defaults]': Show/tune detection thresholds" },
+  { NULL, NULL, NULL },
+};
+
+static struct shell_command_set_t mitigation_shell_command_set = {
+  .next = NULL,
+  .commands = mitigation_shell_commands,
+};
+#endif /* MITIGATION_CONF_WITH_SHELL */
+
 /*---------------------------------------------------------------------------*/
 PROCESS(dio_mitigation_process, "DIO Replay Mitigation Monitor");
 AUTOSTART_PROCESSES(&dio_mitigation_process);
 
+/*---------------------------------------------------------------------------*/
+static void
+sched_init(void)
+{
+  clock_time_t now = clock_time();
+
+  sched_tick = cfg.monitoring_interval;
+  sched_last_tick = now;
+  sched_last_stats = now;
+  sched_last_blacklist = now;
+  sched_dio_mark = dio_received;
+  sched_drop_mark = dio_dropped;
+  etimer_set(&sched_timer, sched_tick * CLOCK_SECOND);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Pick the next tick length from the traffic seen during the last one */
+static void
+sched_adapt(void)
+{
+#if MITIGATION_CONF_LOW_POWER
+  uint16_t cap = dio_received != sched_dio_mark ?
+    SCHED_ACTIVE_TICK_MAX : SCHED_IDLE_TICK_MAX;
+
+  if(dio_dropped != sched_drop_mark) {
+    sched_tick = cfg.monitoring_interval;
+  } else if(sched_tick * 2 <= cap) {
+    sched_tick *= 2;
+  } else if(sched_tick < cap) {
+    sched_tick = cap;
+  }
+  /* A runtime change of the interval also applies when backed off */
+  if(sched_tick < cfg.monitoring_interval) {
+    sched_tick = cfg.monitoring_interval;
+  }
+#else
+  /* Picks up a monitoring interval changed at runtime */
+  sched_tick = cfg.monitoring_interval;
+#endif
+  sched_dio_mark = dio_received;
+  sched_drop_mark = dio_dropped;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Run the housekeeping that is due and re-arm the single timer. In
+ * low-power mode the reports wait for the next tick instead of waking
+ * the node on their own. */
+static void
+sched_run(void)
+{
+  clock_time_t now = clock_time();
+  clock_time_t wait;
+  uint32_t elapsed = (now - sched_last_tick) / CLOCK_SECOND;
+
+  if(elapsed >= sched_tick) {
+    detectors_tick(elapsed);
+    sched_last_tick += elapsed * CLOCK_SECOND;
+    sched_adapt();
+  }
+#if MITIGATION_CONF_WITH_CFS
+  state_checkpoint();
+#endif
+  if(now - sched_last_stats >= STATS_INTERVAL * CLOCK_SECOND) {
+    print_statistics();
+    sched_last_stats = now;
+  }
+  if(now - sched_last_blacklist >= BLACKLIST_PRINT_INTERVAL * CLOCK_SECOND) {
+    print_blacklist();
+    sched_last_blacklist = now;
+  }
+
+  wait = sched_tick * CLOCK_SECOND - (now - sched_last_tick);
+#if !MITIGATION_CONF_LOW_POWER
+  if(STATS_INTERVAL * CLOCK_SECOND - (now - sched_last_stats) < wait) {
+    wait = STATS_INTERVAL * CLOCK_SECOND - (now - sched_last_stats);
+  }
+  if(BLACKLIST_PRINT_INTERVAL * CLOCK_SECOND - (now - sched_last_blacklist) <
+     wait) {
+    wait = BLACKLIST_PRINT_INTERVAL * CLOCK_SECOND - 
+           (now - sched_last_blacklist);
+  }
+#endif
+  etimer_set(&sched_timer, wait);
+}
+
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(dio_mitigation_process, ev, data)
 {
-  static struct etimer monitoring_timer;
-  static struct etimer stats_timer;
-  static struct etimer blacklist_timer;
-  
   PROCESS_BEGIN();
   
+  config_defaults();
+  if(config_load()) {
+    LOG_INFO("Loaded saved configuration from flash\n");
+  }
+  
   LOG_INFO("╔════════════════════════════════════════════╗\n");
   LOG_INFO("║  DIO REPLAY MITIGATION SYSTEM STARTED      ║\n");
   LOG_INFO("╠════════════════════════════════════════════╣\n");
   LOG_INFO("║ Cache size:     %3d entries                ║\n", DIO_CACHE_SIZE);
   LOG_INFO("║ Blacklist size: %3d entries                ║\n", BLACKLIST_SIZE);
-  LOG_INFO("║ BL threshold:   %3d violations             ║\n", BLACKLIST_THRESHOLD);
-  LOG_INFO("║ BL duration:    %3d seconds                ║\n", BLACKLIST_DURATION);
+  LOG_INFO("║ Entry pool:     %3d x %2u bytes             ║\n",
+           MITIGATION_CONF_POOL_BLOCKS, (unsigned)sizeof(pool_block_t));
+  LOG_INFO("║ BL threshold:   %3u violations             ║\n", cfg.blacklist_threshold);
+  LOG_INFO("║ BL duration:    %3u seconds                ║\n", cfg.blacklist_duration);
   LOG_INFO("║ Auto-blacklist: %s                      ║\n", 
-           AUTO_BLACKLIST_ENABLED ? "ENABLED " : "DISABLED");
-  LOG_INFO("║ Time window:    %3d seconds                ║\n", DIO_TIMESTAMP_WINDOW);
-  LOG_INFO("║ Monitor rate:   %3d seconds                ║\n", 
-           (int)(MONITORING_INTERVAL / CLOCK_SECOND));
+           cfg.auto_blacklist ? "ENABLED " : "DISABLED");
+  LOG_INFO("║ Time window:    %3u seconds                ║\n", cfg.timestamp_window);
+  LOG_INFO("║ Monitor rate:   %3u seconds                ║\n", 
+           cfg.monitoring_interval);
+  LOG_INFO("║ Rate limit:     %3u DIOs/sec               ║\n", cfg.max_dio_rate);
+  LOG_INFO("║ Dup window:     %3u seconds                ║\n", cfg.duplicate_window);
+  LOG_INFO("║ Policy:         %s                      ║\n",
+           cfg.policy == POLICY_ADAPTIVE ? "ADAPTIVE" : "STATIC  ");
+  LOG_INFO("║ Scheduler:      %s                     ║\n",
+           MITIGATION_CONF_LOW_POWER ? "LOW-POWER" : "FIXED    ");
+  LOG_INFO("║ LL filter:      %s                      ║\n",
+           MITIGATION_CONF_WITH_LL_FILTER ? "ENABLED " : "DISABLED");
+  LOG_INFO("║ Reset damping:  %s                      ║\n",
+           MITIGATION_TRICKLE_HOOK ? "ENABLED " : "DISABLED");
+  LOG_INFO("║ Quarantine:     %3u violations, +%-5u     ║\n",
+           cfg.quarantine_threshold, cfg.quarantine_margin);
+  LOG_INFO("║ BL digest:      %3d bytes/DIO              ║\n",
+           2 + DIGEST_OPTION_LEN);
   LOG_INFO("╚════════════════════════════════════════════╝\n");
   
   init_cache();
+#if MITIGATION_CONF_WITH_CFS
+  /* Before the tap goes live, so known attackers are blocked from the
+   * first DIO after a reboot */
+  state_load();
+#endif
   
-  etimer_set(&monitoring_timer, MONITORING_INTERVAL);
-  etimer_set(&stats_timer, CLOCK_SECOND * 30);
-  etimer_set(&blacklist_timer, CLOCK_SECOND * 60);
+  netstack_ip_packet_processor_add(&dio_tap_processor);
+  last_report_time = get_timestamp();
+#if MITIGATION_CONF_WITH_SHELL
+  shell_command_set_register(&mitigation_shell_command_set);
+#endif
+  
+  sched_init();
   
   while(1) {
     PROCESS_WAIT_EVENT();
     
-    if(etimer_expired(&monitoring_timer)) {
-      monitor_rpl_neighbors();
-      etimer_reset(&monitoring_timer);
-    }
-    
-    if(etimer_expired(&stats_timer)) {
-      print_statistics();
-      etimer_reset(&stats_timer);
+    if(ev == PROCESS_EVENT_POLL) {
+      check_rpl_side_effects();
+      if(sched_alert) {
+        sched_alert = 0;
+        sched_run();
+      }
     }
     
-    if(etimer_expired(&blacklist_timer)) {
-      print_blacklist();
-      etimer_reset(&blacklist_timer);
+    if(ev == PROCESS_EVENT_TIMER && data == &sched_timer) {
+      sched_wakeups++;
+      sched_run();
     }
   }
   
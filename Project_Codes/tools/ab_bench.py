@@ -0,0 +1,358 @@
+#!/usr/bin/env python3
+"""Headless A/B benchmark for the three DIO replay scenarios.
+
+Runs every scenario under Cooja without a GUI for several random seeds,
+parses the mote output and prints one comparison table with 95%
+confidence intervals.
+
+    ./ab_bench.py --contiki ~/contiki-ng --seeds 1 2 3 4 5
+
+The .csc files reference their firmware through [CONFIG_DIR], so they
+must be run from where they live inside the Contiki tree (the layout
+with baseline/, mitigation/, evaluator/ and attacker/ next to them);
+point --csc-dir there. Seeded copies are written next to the originals
+and removed after each run.
+
+Each run gets its own directory under --out holding the mote log
+(mote.log, Cooja's "MM:SS.mmm<TAB>ID:n<TAB>text" format) and the
+per-run metrics are collected in runs.csv.
+"""
+
+import argparse
+import csv
+import glob
+import math
+import os
+import re
+import shlex
+import shutil
+import subprocess
+import sys
+
+SCENARIOS = [
+    ("no-attack", "without_attacker_unshielded.csc"),
+    ("attack", "baseline_with_attacker_unshielded.csc"),
+    ("mitigation", "with_attacker_mitigation_shielded.csc"),
+]
+
+# Evaluator features a bench run records; off in a plain build
+BENCH_DEFINES = ["EVAL_CONF_WITH_PROBES=1", "EVAL_CONF_WITH_HISTORY=1"]
+
+METRICS = [
+    ("pdr", "PDR (%)"),
+    ("owd_p50", "One-way delay p50 (ms)"),
+    ("owd_p95", "One-way delay p95 (ms)"),
+    ("stability", "Stability score"),
+    ("energy", "Energy (ticks)"),
+    ("lpm", "LPM residency (%)"),
+    ("parent_sw", "Parent switches"),
+    ("ctl", "RPL control (msgs/min)"),
+    ("latency", "Detection latency (s)"),
+    ("recall", "Replay recall (%)"),
+    ("fpr", "False positive rate (%)"),
+]
+
+DEFAULT_COOJA_CMD = ("{contiki}/tools/cooja/gradlew --no-watch-fs --quiet "
+                     "-p {contiki}/tools/cooja run "
+                     "--args='--no-gui --contiki={contiki} "
+                     "--logdir={logdir} {csc}'")
+
+# Replaces the scenario's ScriptRunner script: echo every mote line in
+# Cooja's log format and stop cleanly after the requested duration.
+BENCH_SCRIPT = """TIMEOUT(%d, log.testOK());
+function pad(n, w) { n = String(n); while(n.length < w) n = "0" + n; return n; }
+while(true) {
+  YIELD();
+  var ms = Math.floor(time / 1000);
+  log.log(pad(Math.floor(ms / 60000), 2) + ":" + pad(Math.floor(ms / 1000) %% 60, 2) +
+          "." + pad(ms %% 1000, 3) + "\\tID:" + id + "\\t" + msg + "\\n");
+}
+"""
+
+LINE_RE = re.compile(r"^(\d+):(\d+)(?::(\d+))?\.(\d+)\tID:(\d+)\t(.*)$")
+PROBE_RX_RE = re.compile(r"Received request 'probe (\d+) (\d+) (\d+)'")
+
+# Two-sided 95% Student t critical values, indexed by degrees of freedom
+T95 = [None, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+       2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+       2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+       2.042]
+
+
+def add_make_args(line, make_args):
+    """Append make_args to one make line. DEFINES= lists are joined with
+    one the line already has, since make keeps only the last of them."""
+    for arg in make_args.split():
+        m = re.search(r"\bDEFINES=(\S+)", line)
+        if arg.startswith("DEFINES=") and m:
+            line = line[:m.end()] + "," + arg[len("DEFINES="):] + \
+                line[m.end():]
+        else:
+            line += " " + arg
+    return line
+
+
+def make_seeded_csc(src, dst, seed, duration_s, make_args=""):
+    """Write a copy of src with the given seed and the bench script;
+    make_args is appended to every make line of the mote types."""
+    with open(src, encoding="utf-8") as f:
+        text = f.read()
+    if make_args:
+        text = re.sub(r"<commands>(.*?)</commands>",
+                      lambda m: "<commands>%s</commands>" % "\n".join(
+                          add_make_args(l, xml_escape(make_args))
+                          if l.lstrip().startswith("make ") else l
+                          for l in m.group(1).split("\n")),
+                      text, flags=re.S)
+    text, n = re.subn(r"<randomseed>[^<]*</randomseed>",
+                      "<randomseed>%d</randomseed>" % seed, text)
+    if n != 1:
+        raise ValueError("%s: no <randomseed> element" % src)
+    text, n = re.subn(r"<script>.*?</script>",
+                      lambda m: "<script>%s</script>" % xml_escape(
+                          BENCH_SCRIPT % (duration_s * 1000)),
+                      text, flags=re.S)
+    if n != 1:
+        raise ValueError("%s: no ScriptRunner script" % src)
+    with open(dst, "w", encoding="utf-8") as f:
+        f.write(text)
+
+
+def xml_escape(s):
+    return s.replace("&", "&amp;").replace("<", "&lt;").replace(">", "&gt;")
+
+
+def run_cooja(args, csc, logdir):
+    cmd = args.cooja_cmd.format(contiki=args.contiki, csc=csc, logdir=logdir)
+    with open(os.path.join(logdir, "cooja.out"), "w") as out:
+        rc = subprocess.call(shlex.split(cmd), cwd=logdir,
+                             stdout=out, stderr=subprocess.STDOUT)
+    # ScriptRunner writes <name>.testlog (COOJA.testlog on older Cooja)
+    logs = glob.glob(os.path.join(logdir, "*.testlog"))
+    if not logs:
+        raise RuntimeError("cooja exited %d without a test log, see %s"
+                           % (rc, os.path.join(logdir, "cooja.out")))
+    os.replace(logs[0], os.path.join(logdir, "mote.log"))
+    return rc
+
+
+def run_one(args, scenario, csc_name, seed):
+    """Run one scenario/seed pair and return the path of its mote log."""
+    logdir = os.path.abspath(os.path.join(args.out, "%s-s%d" % (scenario, seed)))
+    os.makedirs(logdir, exist_ok=True)
+    src = os.path.join(args.csc_dir, csc_name)
+    dst = os.path.join(args.csc_dir, ".bench-%s-s%d.csc" % (scenario, seed))
+    make_seeded_csc(src, dst, seed, args.duration,
+                    "DEFINES=" + ",".join(BENCH_DEFINES))
+    try:
+        rc = run_cooja(args, os.path.abspath(dst), logdir)
+    finally:
+        os.remove(dst)
+    if rc != 0:
+        print("warning: %s seed %d: cooja exited %d" % (scenario, seed, rc),
+              file=sys.stderr)
+    return os.path.join(logdir, "mote.log")
+
+
+def parse_time(m):
+    """Seconds from a Cooja timestamp, MM:SS.mmm or HH:MM:SS.mmm."""
+    a, b, c, frac = m.group(1), m.group(2), m.group(3), m.group(4)
+    if c is None:
+        secs = int(a) * 60 + int(b)
+    else:
+        secs = int(a) * 3600 + int(b) * 60 + int(c)
+    return secs + int(frac) / 10 ** len(frac)
+
+
+def parse_log(path):
+    """Reduce one mote log to the per-run metrics.
+
+    Stability, energy and parent switches come from the evaluator's last
+    [CSV] line per mote, averaged over the evaluator motes. PDR pools the evaluator motes' last [PRB] lines:
+    probes echoed by the root over probes sent or held back for lack of
+    a route. One-way delay pairs each probe the root's udp-server logged
+    with its send time; the mote clock is mapped to log time through the
+    clock_ms field of that mote's first [PRB] line.
+    Recall, false positive rate and detection latency come from the last
+    [GT] line of each mitigation mote. Only dessim sends labelled
+    replays, so they are NA for Cooja runs. Latency is the mean, over the motes that
+    blacklisted a replayer, of the time from the first labelled replay
+    they heard to that blacklisting.
+    LPM residency sums the Energest deltas of every [AB] line. RPL
+    control overhead is the DIS/DIO/DAO/DAO-ACK rx+tx rate of each
+    evaluator mote's last [CTL] line, averaged over the motes.
+    """
+    last_csv = {}
+    last_ctl = {}
+    last_gt = {}
+    last_prb = {}
+    clock_offset = {}
+    probe_rx = []
+    cpu_ticks = lpm_ticks = 0
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            m = LINE_RE.match(line.rstrip("\n"))
+            if not m:
+                continue
+            t = parse_time(m)
+            mote, text = int(m.group(5)), m.group(6)
+            if text.startswith("[CSV] "):
+                fields = text[6:].split(",")
+                if len(fields) == 13:
+                    last_csv[mote] = fields
+            elif text.startswith("[CTL] "):
+                fields = text[6:].split(",")
+                if len(fields) == 11:
+                    last_ctl[mote] = [int(v) for v in fields]
+            elif text.startswith("[PRB] "):
+                fields = text[6:].split(",")
+                if len(fields) == 11:
+                    last_prb[mote] = [int(v) for v in fields]
+                    clock_offset.setdefault(mote, t - last_prb[mote][0] / 1000)
+            elif "Received request 'probe " in text:
+                p = PROBE_RX_RE.search(text)
+                if p:
+                    probe_rx.append((int(p.group(1)), int(p.group(3)), t))
+            elif "[GT] " in text:
+                fields = text.split("[GT] ", 1)[1].split(",")
+                if len(fields) == 6:
+                    last_gt[mote] = [int(v) for v in fields]
+            elif "[AB] " in text:
+                fields = text.split("[AB] ", 1)[1].split(",")
+                if len(fields) == 12:
+                    cpu_ticks += int(fields[8])
+                    lpm_ticks += int(fields[9])
+
+    def mean_of(col, conv=float):
+        vals = [conv(f[col]) for f in last_csv.values()]
+        return sum(vals) / len(vals) if vals else None
+
+    tp, fp, tn, fn = (sum(g[i] for g in last_gt.values()) for i in range(4))
+    # 0 in the ttbl_ms field means no blacklisting yet
+    ttbl = [g[5] / 1000.0 for g in last_gt.values() if g[5] > 0]
+    ctl_rates = [60.0 * sum(c[1:9]) / c[0] for c in last_ctl.values() if c[0]]
+    attempts = sum(p[1] + p[2] for p in last_prb.values())
+    owd = sorted(1000.0 * (t - clock_offset[node]) - tx_ms
+                 for node, tx_ms, t in probe_rx if node in clock_offset)
+
+    def pct(q):
+        return owd[int((len(owd) - 1) * q / 100)] if owd else None
+
+    return {
+        "pdr": (100.0 * sum(p[3] for p in last_prb.values()) / attempts
+                if attempts else None),
+        "owd_p50": pct(50),
+        "owd_p95": pct(95),
+        "stability": mean_of(12),
+        "energy": mean_of(10),
+        "lpm": (100.0 * lpm_ticks / (cpu_ticks + lpm_ticks)
+                if cpu_ticks + lpm_ticks else None),
+        "parent_sw": mean_of(4),
+        "ctl": sum(ctl_rates) / len(ctl_rates) if ctl_rates else None,
+        "latency": sum(ttbl) / len(ttbl) if ttbl else None,
+        "recall": 100.0 * tp / (tp + fn) if tp + fn else None,
+        "fpr": 100.0 * fp / (fp + tn) if fp + tn else None,
+    }
+
+
+def mean_ci(values):
+    """Mean and 95% CI half-width; half-width is None for a single sample."""
+    vals = [v for v in values if v is not None]
+    if not vals:
+        return None, None
+    n = len(vals)
+    mean = sum(vals) / n
+    if n < 2:
+        return mean, None
+    var = sum((v - mean) ** 2 for v in vals) / (n - 1)
+    t = T95[n - 1] if n - 1 < len(T95) else 1.96
+    return mean, t * math.sqrt(var / n)
+
+
+def fmt(mean, half):
+    if mean is None:
+        return "NA"
+    if half is None:
+        return "%.1f" % mean
+    return "%.1f ± %.1f" % (mean, half)
+
+
+def print_table(results):
+    names = [s for s, _ in SCENARIOS]
+    rows = [[label] + [fmt(*mean_ci([r[key] for r in results.get(s, [])]))
+                       for s in names]
+            for key, label in METRICS]
+    header = ["Metric"] + ["%s (n=%d)" % (s, len(results.get(s, [])))
+                           for s in names]
+    widths = [max(len(r[i]) for r in rows + [header])
+              for i in range(len(header))]
+    line = lambda cells: "| " + " | ".join(
+        c.ljust(w) for c, w in zip(cells, widths)) + " |"
+    print(line(header))
+    print("|" + "|".join("-" * (w + 2) for w in widths) + "|")
+    for r in rows:
+        print(line(r))
+    print("Detection latency, recall and false positive rate need [GT] "
+          "lines, which only dessim runs produce; NA elsewhere.")
+
+
+def write_runs_csv(path, results):
+    with open(path, "w", newline="") as f:
+        w = csv.writer(f)
+        w.writerow(["scenario", "seed"] + [k for k, _ in METRICS])
+        for scenario, runs in results.items():
+            for r in runs:
+                w.writerow([scenario, r["seed"]] +
+                           ["" if r[k] is None else "%.3f" % r[k]
+                            for k, _ in METRICS])
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    p = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    p.add_argument("--contiki", default=os.environ.get("CONTIKI", ""),
+                   help="Contiki-NG checkout (default: $CONTIKI)")
+    p.add_argument("--csc-dir", default=os.path.dirname(here),
+                   help="directory holding the .csc files")
+    p.add_argument("--seeds", type=int, nargs="+",
+                   default=[123456, 1, 2, 3, 4])
+    p.add_argument("--duration", type=int, default=3600,
+                   help="simulated seconds per run (default: 3600)")
+    p.add_argument("--scenarios", nargs="+",
+                   choices=[s for s, _ in SCENARIOS],
+                   default=[s for s, _ in SCENARIOS])
+    p.add_argument("--out", default="bench-out")
+    p.add_argument("--cooja-cmd", default=DEFAULT_COOJA_CMD,
+                   help="command template, with {contiki} {csc} {logdir}")
+    p.add_argument("--parse-only", action="store_true",
+                   help="only re-parse the logs already in --out")
+    args = p.parse_args()
+
+    if not args.parse_only and not args.contiki:
+        p.error("--contiki or $CONTIKI is required to run Cooja")
+    os.makedirs(args.out, exist_ok=True)
+
+    results = {}
+    for scenario, csc_name in SCENARIOS:
+        if scenario not in args.scenarios:
+            continue
+        for seed in args.seeds:
+            if args.parse_only:
+                log = os.path.join(args.out, "%s-s%d" % (scenario, seed),
+                                   "mote.log")
+                if not os.path.exists(log):
+                    continue
+            else:
+                print("running %s seed %d ..." % (scenario, seed),
+                      file=sys.stderr)
+                log = run_one(args, scenario, csc_name, seed)
+            r = parse_log(log)
+            r["seed"] = seed
+            results.setdefault(scenario, []).append(r)
+
+    write_runs_csv(os.path.join(args.out, "runs.csv"), results)
+    print_table(results)
+
+
+if __name__ == "__main__":
+    main()
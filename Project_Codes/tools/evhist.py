@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Decode the evaluator's on-mote metric history into CSV.
+
+    ./evhist.py mote.log > history.csv
+    ./evhist.py mote.log --mote 7
+
+Typing "history" on an evaluator mote's serial port dumps its history
+buffer, one [HST] line per block (start_s,period_s,samples,hex). Each
+sample is a channel mask byte followed by one zigzag varint per channel
+set in the mask. The varint holds that channel's delta-of-delta. A zero
+mask is followed by a count of consecutive samples in which nothing
+changed. The first sample of a block is coded against zero, so blocks
+decode independently.
+
+Rank and neighbor count are written as levels. The Energest times and
+message counters are cumulative on the mote and are written as the change
+since the previous sample. That change is left empty where the previous
+sample was overwritten on the mote. A block seen in several dumps is
+decoded once, from the dump that holds the most samples of it.
+"""
+
+import argparse
+import csv
+import re
+import sys
+
+CHANNELS = ["rank", "nbrs", "cpu", "lpm", "tx", "rx", "dio_rx", "dis_rx"]
+LEVELS = {"rank", "nbrs"}
+
+HST_RE = re.compile(r"ID:(\d+)\s.*\[HST\] (\d+),(\d+),(\d+),([0-9a-fA-F]*)")
+
+
+def varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def decode_block(data, samples):
+    """Yield the channel values of every sample in one block."""
+    prev = [0] * len(CHANNELS)
+    delta = [0] * len(CHANNELS)
+    pos = n = 0
+    while n < samples and pos < len(data):
+        mask = data[pos]
+        pos += 1
+        if mask == 0:
+            repeat, pos = data[pos], pos + 1
+        else:
+            repeat = 1
+        dods = [0] * len(CHANNELS)
+        for i in range(len(CHANNELS)):
+            if mask & (1 << i):
+                dods[i], pos = varint(data, pos)
+        for _ in range(repeat):
+            for i in range(len(CHANNELS)):
+                d = delta[i] + dods[i]
+                prev[i] = (prev[i] + d) & 0xFFFFFFFF
+                # The key frame sets the level, not a slope
+                delta[i] = 0 if n == 0 else d
+            dods = [0] * len(CHANNELS)
+            yield list(prev)
+            n += 1
+
+
+def read_blocks(path):
+    blocks = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = HST_RE.search(line)
+            if not m:
+                continue
+            mote, start, period, samples = (int(g) for g in m.groups()[:4])
+            key = (mote, start)
+            if key not in blocks or blocks[key][1] < samples:
+                blocks[key] = (period, samples, bytes.fromhex(m.group(5)))
+    return blocks
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    p.add_argument("log", help="Cooja mote output")
+    p.add_argument("--mote", type=int, help="only this mote")
+    args = p.parse_args()
+
+    out = csv.writer(sys.stdout)
+    out.writerow(["mote", "time_s"] + CHANNELS)
+    last = {}
+    for (mote, start), (period, samples, data) in sorted(
+            read_blocks(args.log).items()):
+        if args.mote is not None and mote != args.mote:
+            continue
+        for n, values in enumerate(decode_block(data, samples)):
+            t = start + n * period
+            prev_t, prev = last.get(mote, (None, None))
+            row = [mote, t]
+            for i, name in enumerate(CHANNELS):
+                if name in LEVELS:
+                    row.append(values[i])
+                elif prev_t == t - period:
+                    row.append((values[i] - prev[i]) & 0xFFFFFFFF)
+                else:
+                    row.append("")
+            out.writerow(row)
+            last[mote] = (t, values)
+
+
+if __name__ == "__main__":
+    main()
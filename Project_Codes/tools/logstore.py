@@ -0,0 +1,324 @@
+#!/usr/bin/env python3
+"""Columnar, compressed store for Cooja mote logs and radio traces.
+
+    ./logstore.py convert all_motes_logs.txt run.mlc
+    ./logstore.py query run.mlc --mote 99 --from-min 10 --to-min 20 --event DIO
+    ./logstore.py info run.mlc
+
+Two inputs are understood: mote output ("MM:SS.mmm<TAB>ID:n<TAB>text")
+and the radio logger export ("ms<TAB>src<TAB>dsts<TAB>len: ...|hex").
+
+Every line becomes one row with these columns:
+  time    uint32 ms, delta-coded
+  mote    uint16 source mote id
+  event   uint8 event type (EVENTS below)
+  tmpl    uint32 index into the template dictionary
+  nnum    uint8 count of numbers lifted out of the text
+  nums    int64 the numbers themselves (ragged, nnum per row)
+
+The template is the line text with each plain decimal number replaced by
+a placeholder. Repeated statistics lines therefore collapse to a few
+dictionary entries, and replayed frames, whose hex payload is identical,
+share one entry.
+
+Rows are cut into chunks. Each column of a chunk is zlib-compressed on
+its own. A chunk index at the end records each chunk's time range, event
+mask and mote mask, so a query only decompresses the chunks it can
+match. The file is read through mmap and never parsed as text again.
+
+File layout (little-endian):
+  header   "MLC1" u16 version u16 kind u32 rows u32 chunks u32 chunk_rows
+           u64 dict_off u64 index_off
+  chunks   compressed column blobs
+  dict     u32 count, zlib("\\n".join(templates))
+  index    per chunk: u32 t_min u32 t_max u32 event_mask u32 rows
+           32-byte mote mask, then (u64 off, u32 clen) x 6 columns
+"""
+
+import argparse
+import mmap
+import re
+import struct
+import sys
+import zlib
+from array import array
+
+MAGIC = b"MLC1"
+VERSION = 1
+KIND_MOTE, KIND_RADIO = 0, 1
+CHUNK_ROWS = 4096
+HEADER = struct.Struct("<4sHHIII QQ")
+INDEX_HEAD = struct.Struct("<IIII32s")
+COLUMN_REF = struct.Struct("<QI")
+COLUMNS = [("time", "I"), ("mote", "H"), ("event", "B"),
+           ("tmpl", "I"), ("nnum", "B"), ("nums", "q")]
+
+EVENTS = ["OTHER", "DIO", "DIS", "DAO", "REPLAY", "BLACKLIST", "CSV", "AB",
+          "ACK"]
+
+PLACEHOLDER = "\x00"
+# Plain decimal numbers only: no leading zeros, not glued to hex or words,
+# so the template round-trips exactly.
+NUMBER_RE = re.compile(r"(?<![0-9A-Za-z.])(0|[1-9][0-9]{0,17})(?![0-9A-Za-z])")
+MOTE_RE = re.compile(r"^(\d+):(\d+)(?::(\d+))?\.(\d{3})\tID:(\d+)\t(.*)$")
+RADIO_RE = re.compile(r"^(\d+)\t(\d+)\t(.*)$")
+
+
+def classify(text):
+    if "[CSV]" in text:
+        return EVENTS.index("CSV")
+    if "[AB]" in text:
+        return EVENTS.index("AB")
+    if "BLACKLIST" in text:
+        return EVENTS.index("BLACKLIST")
+    if "REPLAY" in text:
+        return EVENTS.index("REPLAY")
+    for ev in ("DIO", "DIS", "DAO"):
+        if ev in text:
+            return EVENTS.index(ev)
+    if ": 15.4 A" in text:
+        return EVENTS.index("ACK")
+    return 0
+
+
+def split_numbers(text):
+    nums = [int(n) for n in NUMBER_RE.findall(text)]
+    return NUMBER_RE.sub(PLACEHOLDER, text.replace(PLACEHOLDER, "")), nums
+
+
+def fill_numbers(tmpl, nums):
+    it = iter(nums)
+    return re.sub(PLACEHOLDER, lambda m: str(next(it)), tmpl)
+
+
+def parse_line(line, kind):
+    """(time_ms, mote, text) for one input line, or None to skip it."""
+    if kind == KIND_MOTE:
+        m = MOTE_RE.match(line)
+        if not m:
+            return None
+        a, b, c = int(m.group(1)), int(m.group(2)), m.group(3)
+        secs = a * 60 + b if c is None else a * 3600 + b * 60 + int(c)
+        return secs * 1000 + int(m.group(4)), int(m.group(5)), m.group(6)
+    m = RADIO_RE.match(line)
+    if not m:
+        return None
+    return int(m.group(1)), int(m.group(2)), m.group(3)
+
+
+def detect_kind(path):
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            if MOTE_RE.match(line):
+                return KIND_MOTE
+            if RADIO_RE.match(line):
+                return KIND_RADIO
+    raise ValueError("%s: neither a mote log nor a radio trace" % path)
+
+
+class Writer:
+    """Streams rows into an .mlc file, one chunk at a time."""
+
+    def __init__(self, path, kind, chunk_rows=CHUNK_ROWS):
+        self.f = open(path, "wb")
+        self.kind = kind
+        self.chunk_rows = chunk_rows
+        self.rows = 0
+        self.templates = {}
+        self.index = []
+        self.f.write(b"\0" * HEADER.size)
+        self._reset()
+
+    def _reset(self):
+        self.cols = {name: array(code) for name, code in COLUMNS}
+        self.event_mask = 0
+        self.mote_mask = 0
+
+    def append(self, time_ms, mote, text):
+        tmpl, nums = split_numbers(text)
+        ev = classify(text)
+        c = self.cols
+        c["time"].append(time_ms)
+        c["mote"].append(mote)
+        c["event"].append(ev)
+        c["tmpl"].append(self.templates.setdefault(tmpl, len(self.templates)))
+        c["nnum"].append(min(len(nums), 255))
+        c["nums"].extend(nums[:255])
+        self.event_mask |= 1 << ev
+        self.mote_mask |= 1 << (mote & 0xFF)
+        self.rows += 1
+        if len(c["time"]) == self.chunk_rows:
+            self._flush()
+
+    def _flush(self):
+        c = self.cols
+        n = len(c["time"])
+        if n == 0:
+            return
+        t_min, t_max = min(c["time"]), max(c["time"])
+        # Delta-code time so the column compresses to almost nothing
+        times = c["time"]
+        deltas = array("I", [times[0]] + [(times[i] - times[i - 1]) & 0xFFFFFFFF
+                                          for i in range(1, n)])
+        c["time"] = deltas
+        refs = []
+        for name, _ in COLUMNS:
+            blob = zlib.compress(c[name].tobytes(), 6)
+            refs.append((self.f.tell(), len(blob)))
+            self.f.write(blob)
+        self.index.append((t_min, t_max, self.event_mask, n,
+                           self.mote_mask.to_bytes(32, "little"), refs))
+        self._reset()
+
+    def close(self):
+        self._flush()
+        dict_off = self.f.tell()
+        ordered = sorted(self.templates, key=self.templates.get)
+        blob = zlib.compress("\n".join(ordered).encode("utf-8"), 9)
+        self.f.write(struct.pack("<I", len(ordered)) + blob)
+        index_off = self.f.tell()
+        for t_min, t_max, ev_mask, n, motes, refs in self.index:
+            self.f.write(INDEX_HEAD.pack(t_min, t_max, ev_mask, n, motes))
+            for off, clen in refs:
+                self.f.write(COLUMN_REF.pack(off, clen))
+        self.f.seek(0)
+        self.f.write(HEADER.pack(MAGIC, VERSION, self.kind, self.rows,
+                                 len(self.index), self.chunk_rows,
+                                 dict_off, index_off))
+        self.f.close()
+
+
+class Reader:
+    """Memory-maps an .mlc file and answers filtered row queries."""
+
+    def __init__(self, path):
+        self.f = open(path, "rb")
+        self.mm = mmap.mmap(self.f.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, version, self.kind, self.rows, n_chunks, self.chunk_rows,
+         dict_off, index_off) = HEADER.unpack_from(self.mm, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError("%s: not an MLC%d file" % (path, VERSION))
+        count, = struct.unpack_from("<I", self.mm, dict_off)
+        text = zlib.decompress(self.mm[dict_off + 4:index_off]).decode("utf-8")
+        self.templates = text.split("\n") if count else []
+        self.chunks = []
+        pos = index_off
+        for _ in range(n_chunks):
+            head = INDEX_HEAD.unpack_from(self.mm, pos)
+            pos += INDEX_HEAD.size
+            refs = []
+            for _ in COLUMNS:
+                refs.append(COLUMN_REF.unpack_from(self.mm, pos))
+                pos += COLUMN_REF.size
+            self.chunks.append((head, refs))
+
+    def close(self):
+        self.mm.close()
+        self.f.close()
+
+    def _column(self, refs, i):
+        off, clen = refs[i]
+        col = array(COLUMNS[i][1])
+        col.frombytes(zlib.decompress(self.mm[off:off + clen]))
+        return col
+
+    def rows_where(self, mote=None, t0=None, t1=None, event=None):
+        """Yield (time_ms, mote, event_name, text) for rows matching all
+        given filters; t0 is inclusive, t1 exclusive, both in ms."""
+        ev_bit = None if event is None else 1 << EVENTS.index(event)
+        for (t_min, t_max, ev_mask, n, motes), refs in self.chunks:
+            if t0 is not None and t_max < t0:
+                continue
+            if t1 is not None and t_min >= t1:
+                continue
+            if ev_bit is not None and not ev_mask & ev_bit:
+                continue
+            if mote is not None and not (int.from_bytes(motes, "little")
+                                         >> (mote & 0xFF)) & 1:
+                continue
+            times = self._column(refs, 0)
+            for i in range(1, n):
+                times[i] = (times[i] + times[i - 1]) & 0xFFFFFFFF
+            mote_col = self._column(refs, 1)
+            ev_col = self._column(refs, 2)
+            tmpl_col = self._column(refs, 3)
+            nnum = self._column(refs, 4)
+            nums = self._column(refs, 5)
+            k = 0
+            for i in range(n):
+                j = k
+                k += nnum[i]
+                if mote is not None and mote_col[i] != mote:
+                    continue
+                if ev_bit is not None and not (1 << ev_col[i]) & ev_bit:
+                    continue
+                t = times[i]
+                if (t0 is not None and t < t0) or (t1 is not None and t >= t1):
+                    continue
+                yield (t, mote_col[i], EVENTS[ev_col[i]],
+                       fill_numbers(self.templates[tmpl_col[i]], nums[j:k]))
+
+    def format_row(self, row):
+        t, mote, _, text = row
+        if self.kind == KIND_RADIO:
+            return "%d\t%d\t%s" % (t, mote, text)
+        return "%02d:%02d.%03d\tID:%d\t%s" % (t // 60000, t // 1000 % 60,
+                                             t % 1000, mote, text)
+
+
+def convert(src, dst):
+    kind = detect_kind(src)
+    w = Writer(dst, kind)
+    with open(src, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            row = parse_line(line.rstrip("\n"), kind)
+            if row is not None:
+                w.append(*row)
+    w.close()
+    return w.rows, len(w.templates)
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    sub = p.add_subparsers(dest="cmd", required=True)
+    c = sub.add_parser("convert", help="text log or trace to .mlc")
+    c.add_argument("src")
+    c.add_argument("dst")
+    q = sub.add_parser("query", help="print matching rows")
+    q.add_argument("file")
+    q.add_argument("--mote", type=int)
+    q.add_argument("--event", choices=EVENTS)
+    q.add_argument("--from-min", type=float)
+    q.add_argument("--to-min", type=float)
+    q.add_argument("--count", action="store_true",
+                   help="print the number of matching rows only")
+    i = sub.add_parser("info", help="row, chunk and dictionary counts")
+    i.add_argument("file")
+    args = p.parse_args()
+
+    if args.cmd == "convert":
+        rows, tmpls = convert(args.src, args.dst)
+        print("%d rows, %d templates" % (rows, tmpls), file=sys.stderr)
+        return
+
+    r = Reader(args.file)
+    try:
+        if args.cmd == "info":
+            print("kind: %s" % ("radio" if r.kind == KIND_RADIO else "mote"))
+            print("rows: %d in %d chunks" % (r.rows, len(r.chunks)))
+            print("templates: %d" % len(r.templates))
+            return
+        t0 = None if args.from_min is None else int(args.from_min * 60000)
+        t1 = None if args.to_min is None else int(args.to_min * 60000)
+        rows = r.rows_where(args.mote, t0, t1, args.event)
+        if args.count:
+            print(sum(1 for _ in rows))
+        else:
+            for row in rows:
+                print(r.format_row(row))
+    finally:
+        r.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+"""Parallel, resumable parameter sweep over the Cooja scenarios.
+
+    ./sweep.py --contiki ~/contiki-ng --csc-dir <dir> --seeds 1 2 3 \\
+        --set BLACKLIST_THRESHOLD=3,5,8 --set MAX_DIO_RATE=2,3
+
+Every combination of scenario, seed and --set values is an independent
+job. Jobs run concurrently, --jobs at a time (default: all cores). Each
+job runs in a private copy of --workspace, so the parallel `make clean`
+steps Cooja runs for every mote type cannot collide. --set values reach
+the firmware as DEFINES= on those make lines, after the evaluator
+features ab_bench.py turns on. The mitigation's boot defaults are
+#ifndef-guarded so they can be overridden this way.
+
+As each job finishes, its metrics are appended to results.jsonl under
+--out and flushed to disk. A rerun skips every job already in that file,
+so a crashed or interrupted sweep resumes where it stopped. A job whose
+runner exits non-zero is not recorded: it stays out of the report and
+is retried on the next run. Mote logs
+are kept as compressed .mlc files (see logstore.py) unless --keep-text
+is given.
+
+The final report groups results by scenario and overrides. It also
+gives the wall-clock speedup against running the same jobs serially,
+estimated as the sum of the per-job wall times.
+
+Any headless runner works through --cooja-cmd, e.g. a native-target
+build whose output is redirected into {logdir}/x.testlog.
+"""
+
+import argparse
+import concurrent.futures
+import itertools
+import json
+import os
+import shutil
+import sys
+import time
+
+from ab_bench import (BENCH_DEFINES, DEFAULT_COOJA_CMD, METRICS, SCENARIOS,
+                      fmt, make_seeded_csc, mean_ci, parse_log, run_cooja)
+import logstore
+
+WORKSPACE_IGNORE = shutil.ignore_patterns(
+    ".git", "build", "obj_*", "*.cooja", "bench-out", "sweep-out")
+
+
+def parse_sets(sets):
+    """["A=1,2", "B=3"] -> [{"A": "1", "B": "3"}, {"A": "2", "B": "3"}]"""
+    axes = []
+    for item in sets:
+        name, _, values = item.partition("=")
+        if not name or not values:
+            raise ValueError("--set expects NAME=v1,v2,...: %r" % item)
+        axes.append([(name, v) for v in values.split(",")])
+    return [dict(combo) for combo in itertools.product(*axes)]
+
+
+def job_key(scenario, seed, overrides):
+    tag = ",".join("%s=%s" % kv for kv in sorted(overrides.items()))
+    return "%s-s%d%s" % (scenario, seed, "-" + tag if tag else "")
+
+
+def load_done(path):
+    done = {}
+    if os.path.exists(path):
+        with open(path) as f:
+            for line in f:
+                try:
+                    rec = json.loads(line)
+                except ValueError:
+                    continue  # torn last line from a crash
+                if rec.get("rc", 0) != 0:
+                    continue  # failed run from an older sweep: redo it
+                done[rec["key"]] = rec
+    return done
+
+
+def run_job(args, scenario, csc_name, seed, overrides):
+    """Run one job in its own workspace and return its result record."""
+    key = job_key(scenario, seed, overrides)
+    logdir = os.path.abspath(os.path.join(args.out, "runs", key))
+    shutil.rmtree(logdir, ignore_errors=True)
+    ws = os.path.join(logdir, "ws")
+    root = os.path.abspath(args.workspace)
+    shutil.copytree(root, ws, ignore=WORKSPACE_IGNORE)
+    csc_dir = os.path.join(ws, os.path.relpath(os.path.abspath(args.csc_dir),
+                                               root))
+    dst = os.path.join(csc_dir, ".sweep.csc")
+
+    make_args = "CONTIKI=%s DEFINES=%s" % (
+        os.path.abspath(args.contiki), ",".join(
+            BENCH_DEFINES +
+            ["%s=%s" % kv for kv in sorted(overrides.items())]))
+    make_seeded_csc(os.path.join(csc_dir, csc_name), dst, seed,
+                    args.duration, make_args)
+
+    start = time.monotonic()
+    try:
+        rc = run_cooja(args, dst, logdir)
+        log = os.path.join(logdir, "mote.log")
+        metrics = parse_log(log)
+        logstore.convert(log, os.path.join(logdir, "mote.mlc"))
+        if not args.keep_text:
+            os.remove(log)
+    finally:
+        shutil.rmtree(ws, ignore_errors=True)
+    return {"key": key, "scenario": scenario, "seed": seed,
+            "overrides": overrides, "rc": rc,
+            "wall_s": round(time.monotonic() - start, 3),
+            "metrics": metrics}
+
+
+def print_report(records, session_wall, session_serial, jobs):
+    groups = {}
+    for rec in records:
+        tag = ",".join("%s=%s" % kv for kv in sorted(rec["overrides"].items()))
+        groups.setdefault((rec["scenario"], tag), []).append(rec)
+
+    header = ["Scenario", "Overrides", "n"] + [label for _, label in METRICS]
+    rows = []
+    order = [s for s, _ in SCENARIOS]
+    for (scenario, tag), recs in sorted(
+            groups.items(), key=lambda g: (order.index(g[0][0]), g[0][1])):
+        rows.append([scenario, tag or "-", str(len(recs))] +
+                    [fmt(*mean_ci([r["metrics"][k] for r in recs]))
+                     for k, _ in METRICS])
+    widths = [max(len(r[i]) for r in rows + [header])
+              for i in range(len(header))]
+    line = lambda cells: "| " + " | ".join(
+        c.ljust(w) for c, w in zip(cells, widths)) + " |"
+    print(line(header))
+    print("|" + "|".join("-" * (w + 2) for w in widths) + "|")
+    for r in rows:
+        print(line(r))
+
+    if session_wall > 0 and session_serial > 0:
+        speedup = session_serial / session_wall
+        print("\nThis session: %.0f s wall, %.0f s serial estimate, "
+              "speedup %.2fx on %d workers (%.0f%% efficiency)"
+              % (session_wall, session_serial, speedup, jobs,
+                 100.0 * speedup / jobs))
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    p = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    p.add_argument("--contiki", default=os.environ.get("CONTIKI", ""),
+                   help="Contiki-NG checkout (default: $CONTIKI)")
+    p.add_argument("--csc-dir", default=os.path.dirname(here),
+                   help="directory holding the .csc files")
+    p.add_argument("--workspace",
+                   help="tree copied per job; must contain --csc-dir and "
+                        "everything its [CONFIG_DIR] paths reach "
+                        "(default: parent of --csc-dir)")
+    p.add_argument("--seeds", type=int, nargs="+", default=[123456])
+    p.add_argument("--set", dest="sets", action="append", default=[],
+                   metavar="NAME=v1,v2", help="firmware define to sweep")
+    p.add_argument("--scenarios", nargs="+",
+                   choices=[s for s, _ in SCENARIOS],
+                   default=[s for s, _ in SCENARIOS])
+    p.add_argument("--duration", type=int, default=3600,
+                   help="simulated seconds per run (default: 3600)")
+    p.add_argument("--jobs", type=int, default=os.cpu_count() or 1)
+    p.add_argument("--out", default="sweep-out")
+    p.add_argument("--cooja-cmd", default=DEFAULT_COOJA_CMD,
+                   help="command template, with {contiki} {csc} {logdir}")
+    p.add_argument("--keep-text", action="store_true",
+                   help="keep mote.log next to mote.mlc")
+    p.add_argument("--report-only", action="store_true",
+                   help="print the report from results.jsonl and exit")
+    args = p.parse_args()
+
+    if args.workspace is None:
+        args.workspace = os.path.dirname(os.path.abspath(args.csc_dir))
+    os.makedirs(args.out, exist_ok=True)
+    store = os.path.join(args.out, "results.jsonl")
+    done = load_done(store)
+
+    if args.report_only:
+        print_report(list(done.values()), 0, 0, args.jobs)
+        return
+    if not args.contiki:
+        p.error("--contiki or $CONTIKI is required to run Cooja")
+
+    csc = dict(SCENARIOS)
+    todo = [(s, csc[s], seed, ov)
+            for s in args.scenarios
+            for seed in args.seeds
+            for ov in parse_sets(args.sets)
+            if job_key(s, seed, ov) not in done]
+    print("%d jobs, %d already done, %d workers"
+          % (len(todo) + len(done), len(done), args.jobs), file=sys.stderr)
+
+    serial = 0.0
+    failed = 0
+    start = time.monotonic()
+    with open(store, "a") as out, \
+            concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+        futures = {pool.submit(run_job, args, *job): job for job in todo}
+        for fut in concurrent.futures.as_completed(futures):
+            job = futures[fut]
+            try:
+                rec = fut.result()
+            except Exception as e:  # one bad run must not stop the sweep
+                print("failed %s: %s" % (job_key(job[0], job[2], job[3]), e),
+                      file=sys.stderr)
+                failed += 1
+                continue
+            serial += rec["wall_s"]
+            if rec["rc"] != 0:
+                # Partial logs would skew the means; leave it for a rerun
+                print("failed %s: runner exited with %d, see %s"
+                      % (rec["key"], rec["rc"],
+                         os.path.join(args.out, "runs", rec["key"])),
+                      file=sys.stderr)
+                failed += 1
+                continue
+            out.write(json.dumps(rec, sort_keys=True) + "\n")
+            out.flush()
+            os.fsync(out.fileno())
+            done[rec["key"]] = rec
+            print("done %s (%.0f s)" % (rec["key"], rec["wall_s"]),
+                  file=sys.stderr)
+    print_report(list(done.values()), time.monotonic() - start, serial,
+                 args.jobs)
+    if failed:
+        print("%d jobs failed and are not in the report; rerun to retry them"
+              % failed, file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
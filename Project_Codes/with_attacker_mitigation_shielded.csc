@@ -48,7 +48,7 @@ make udp-server.cooja TARGET=cooja</commands>
       <description>RPL Node (Protected)</description>
       <source>[CONFIG_DIR]/mitigation/rpl-dio-replay-mitigation.c</source>
       <commands>make clean TARGET=cooja
-make rpl-dio-replay-mitigation.cooja TARGET=cooja</commands>
+make rpl-dio-replay-mitigation.cooja TARGET=cooja DEFINES=RPL_CALLBACK_NEW_DIO_INTERVAL=mitigation_dio_interval</commands>
       <moteinterface>org.contikios.cooja.interfaces.Position</moteinterface>
       <moteinterface>org.contikios.cooja.interfaces.Battery</moteinterface>
       <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiVib</moteinterface>